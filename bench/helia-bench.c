@@ -0,0 +1,562 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+/*
+ * helia-bench <load | demux | record | zap> [ --ts file.ts ] [ --json out.json ] [ --num N ]
+ *
+ * load   - parse and index N synthetic gtv-channel.conf lines ( default 100000 )
+ * demux  - TS packets/s through tsparse ! tsdemux with N multi views ( default 4 )
+ * record - CPU per recording branch, 1..N branches on one tee ( default 3 )
+ * zap    - time to the first video buffer at the sink, N cold and N same-transponder zaps ( default 5 ); needs a display
+ *
+ * The TS file is replayed with HELIA_TS_PACE=fast; exit code 77 means skipped.
+ */
+
+#include "dvb.h"
+#include "include.h"
+#include "dvb-rec.h"
+#include "dvb-tune.h"
+#include "ts-file.h"
+#include "chan-model.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <sys/resource.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/mpegts/mpegts.h>
+
+#define BENCH_SKIP 77
+
+typedef struct _Bench Bench;
+
+struct _Bench
+{
+	const char *name;
+	const char *ts;
+	const char *json;
+
+	uint num;
+
+	GString *result;
+	GMainLoop *loop;
+
+	GArray *sids;
+
+	gint64 time;
+	guint64 bytes;
+	gboolean wait;
+	gboolean fresh;
+	GArray *runs;
+
+	uint src_tm;
+};
+
+static double bench_ms ( gint64 usec )
+{
+	return (double)usec / 1000.0;
+}
+
+static double bench_cpu ( void )
+{
+	struct rusage usage;
+	getrusage ( RUSAGE_SELF, &usage );
+
+	return (double)( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1000.0 + (double)( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) / 1000.0;
+}
+
+static void bench_json_runs ( GString *gstring, const char *key, GArray *runs )
+{
+	g_string_append_printf ( gstring, ", \"%s\": [", key );
+
+	uint i = 0; for ( i = 0; i < runs->len; i++ )
+		g_string_append_printf ( gstring, "%s%.3f", ( i ) ? ", " : "", g_array_index ( runs, double, i ) );
+
+	g_string_append ( gstring, "]" );
+}
+
+static int bench_write ( Bench *bench )
+{
+	g_string_prepend ( bench->result, "\", " );
+	g_string_prepend ( bench->result, bench->name );
+	g_string_prepend ( bench->result, "{ \"bench\": \"" );
+	g_string_append  ( bench->result, " }\n" );
+
+	fputs ( bench->result->str, stdout );
+
+	GError *err = NULL;
+
+	if ( bench->json && !g_file_set_contents ( bench->json, bench->result->str, (gssize)bench->result->len, &err ) )
+	{
+		g_critical ( "%s:: %s ", __func__, err->message );
+		g_error_free ( err );
+
+		return 1;
+	}
+
+	return 0;
+}
+
+static gboolean bench_bus ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, Bench *bench )
+{
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ELEMENT && bench->sids )
+	{
+		GstMpegtsSection *section = gst_message_parse_mpegts_section ( msg );
+
+		if ( section && GST_MPEGTS_SECTION_TYPE ( section ) == GST_MPEGTS_SECTION_PAT && bench->sids->len == 0 )
+		{
+			GPtrArray *pat = gst_mpegts_section_get_pat ( section );
+
+			uint i = 0; for ( i = 0; pat && i < pat->len; i++ )
+			{
+				GstMpegtsPatProgram *program = g_ptr_array_index ( pat, i );
+
+				if ( program->program_number ) g_array_append_val ( bench->sids, program->program_number );
+			}
+
+			if ( pat ) g_ptr_array_unref ( pat );
+
+			g_main_loop_quit ( bench->loop );
+		}
+
+		if ( section ) gst_mpegts_section_unref ( section );
+	}
+
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ERROR )
+	{
+		GError *err = NULL;
+		gst_message_parse_error ( msg, &err, NULL );
+
+		g_critical ( "%s:: %s ", __func__, err->message );
+		g_error_free ( err );
+
+		g_main_loop_quit ( bench->loop );
+	}
+
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_EOS ) g_main_loop_quit ( bench->loop );
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void bench_run ( GstElement *pipeline, Bench *bench )
+{
+	GstBus *bus = gst_element_get_bus ( pipeline );
+	uint bus_id = gst_bus_add_watch ( bus, (GstBusFunc)bench_bus, bench );
+	gst_object_unref ( bus );
+
+	gst_element_set_state ( pipeline, GST_STATE_PLAYING );
+
+	g_main_loop_run ( bench->loop );
+
+	gst_element_set_state ( pipeline, GST_STATE_NULL );
+
+	g_source_remove ( bus_id );
+}
+
+/* Programs of the replayed transponder, from its PAT */
+static void bench_get_sids ( Bench *bench )
+{
+	GstElement *pipeline = gst_pipeline_new ( NULL );
+	GstElement *src      = ts_file_make_src ();
+	GstElement *tsparse  = gst_element_factory_make ( "tsparse",  NULL );
+	GstElement *fakesink = gst_element_factory_make ( "fakesink", NULL );
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), src, tsparse, fakesink, NULL );
+	gst_element_link_many ( src, tsparse, fakesink, NULL );
+
+	bench->sids = g_array_new ( FALSE, FALSE, sizeof ( uint16_t ) );
+
+	bench_run ( pipeline, bench );
+
+	gst_object_unref ( pipeline );
+}
+
+static char * bench_chan_data ( uint16_t sid )
+{
+	return g_strdup_printf ( "Bench %u:delsys=3:adapter=0:frontend=0:frequency=0:program-number=%u", sid, sid );
+}
+
+static int bench_load ( Bench *bench )
+{
+	uint i = 0, num = ( bench->num ) ? bench->num : 100000;
+
+	GString *gstring = g_string_new ( "# Gtv-Dvb channel format \n" );
+
+	for ( i = 0; i < num; i++ )
+		g_string_append_printf ( gstring, "Channel %u:delsys=3:adapter=0:frontend=0:frequency=%u:inversion=2:bandwidth-hz=8000000:"
+			"code-rate-hp=9:code-rate-lp=9:modulation=6:trans-mode=2:guard=4:hierarchy=4:program-number=%u\n", i, 474000000 + ( i / 16 ) * 8000000, i % 16 + 1 );
+
+	g_autofree char *path = g_build_filename ( g_get_tmp_dir (), "helia-bench-channels.conf", NULL );
+
+	g_file_set_contents ( path, gstring->str, (gssize)gstring->len, NULL );
+	g_string_free ( gstring, TRUE );
+
+	gint64 time = g_get_monotonic_time ();
+
+	/* The loader of treeview.c: a mapped file appended in CHAN_LOAD_BATCH idle batches */
+	GMappedFile *map = g_mapped_file_new ( path, FALSE, NULL );
+	ChanModel *model = chan_model_new ();
+
+	const char *pos = ( map ) ? g_mapped_file_get_contents ( map ) : NULL;
+	const char *end = ( map ) ? pos + g_mapped_file_get_length ( map ) : NULL;
+
+	while ( pos && chan_model_load ( model, &pos, end, CHAN_LOAD_BATCH ) );
+
+	gint64 elapsed = g_get_monotonic_time () - time;
+
+	uint rows = chan_model_get_n ( model );
+
+	g_object_unref ( model );
+	if ( map ) g_mapped_file_unref ( map );
+
+	g_unlink ( path );
+
+	g_string_append_printf ( bench->result, "\"lines\": %u, \"ms\": %.3f, \"lines_per_s\": %.0f", rows, bench_ms ( elapsed ), rows / ( (double)elapsed / G_USEC_PER_SEC ) );
+
+	return bench_write ( bench );
+}
+
+static GstPadProbeReturn bench_count ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, Bench *bench )
+{
+	GstBuffer *buffer = gst_pad_probe_info_get_buffer ( info );
+
+	if ( buffer ) bench->bytes += gst_buffer_get_size ( buffer );
+
+	return GST_PAD_PROBE_OK;
+}
+
+static void bench_demux_pad ( G_GNUC_UNUSED GstElement *demux, GstPad *pad, GstElement *pipeline )
+{
+	GstElement *fakesink = gst_element_factory_make ( "fakesink", NULL );
+
+	g_object_set ( fakesink, "sync", FALSE, NULL );
+
+	gst_bin_add ( GST_BIN ( pipeline ), fakesink );
+	gst_element_sync_state_with_parent ( fakesink );
+
+	dvb_pad_link ( pad, fakesink, "bench" );
+}
+
+/* The multi view topology of dvb.c: tee ! queue ! tsparse, program_%u ! queue2 ! tsdemux per view */
+static int bench_demux ( Bench *bench )
+{
+	uint views = ( bench->num ) ? bench->num : 4;
+
+	GstElement *pipeline = gst_pipeline_new ( NULL );
+	GstElement *src      = ts_file_make_src ();
+	GstElement *queue    = gst_element_factory_make ( "queue",   NULL );
+	GstElement *tsparse  = gst_element_factory_make ( "tsparse", NULL );
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), src, queue, tsparse, NULL );
+	gst_element_link_many ( src, queue, tsparse, NULL );
+
+	uint i = 0, linked = 0;
+
+	for ( i = 0; i < bench->sids->len && linked < views; i++ )
+	{
+		char name[20];
+		sprintf ( name, "program_%u", g_array_index ( bench->sids, uint16_t, i ) );
+
+		GstPad *pad = gst_element_get_request_pad ( tsparse, name );
+
+		if ( !pad ) continue;
+
+		GstElement *queue2 = gst_element_factory_make ( "queue2",  NULL );
+		GstElement *demux  = gst_element_factory_make ( "tsdemux", NULL );
+
+		g_object_set ( demux, "program-number", g_array_index ( bench->sids, uint16_t, i ), NULL );
+		g_signal_connect ( demux, "pad-added", G_CALLBACK ( bench_demux_pad ), pipeline );
+
+		gst_bin_add_many ( GST_BIN ( pipeline ), queue2, demux, NULL );
+		gst_element_link ( queue2, demux );
+
+		dvb_pad_link ( pad, queue2, "bench" );
+		gst_object_unref ( pad );
+
+		linked++;
+	}
+
+	GstPad *pad_src = gst_element_get_static_pad ( src, "src" );
+	gst_pad_add_probe ( pad_src, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)bench_count, bench, NULL );
+	gst_object_unref ( pad_src );
+
+	double cpu = bench_cpu ();
+	gint64 time = g_get_monotonic_time ();
+
+	bench_run ( pipeline, bench );
+
+	gint64 elapsed = g_get_monotonic_time () - time;
+	cpu = bench_cpu () - cpu;
+
+	gst_object_unref ( pipeline );
+
+	double packets = (double)bench->bytes / 188;
+
+	g_string_append_printf ( bench->result, "\"views\": %u, \"packets\": %.0f, \"ms\": %.3f, \"cpu_ms\": %.3f, \"packets_per_s\": %.0f",
+		linked, packets, bench_ms ( elapsed ), cpu, packets / ( (double)elapsed / G_USEC_PER_SEC ) );
+
+	return bench_write ( bench );
+}
+
+static double bench_record_run ( Bench *bench, uint branches )
+{
+	GstElement *pipeline = gst_pipeline_new ( NULL );
+	GstElement *src      = ts_file_make_src ();
+	GstElement *tee      = gst_element_factory_make ( "tee",      NULL );
+	GstElement *queue    = gst_element_factory_make ( "queue",    NULL );
+	GstElement *fakesink = gst_element_factory_make ( "fakesink", NULL );
+
+	g_object_set ( fakesink, "sync", FALSE, NULL );
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), src, tee, queue, fakesink, NULL );
+	gst_element_link_many ( src, tee, queue, fakesink, NULL );
+
+	uint16_t sid = g_array_index ( bench->sids, uint16_t, 0 );
+
+	uint i = 0; for ( i = 0; i < branches; i++ )
+	{
+		g_autofree char *name = g_strdup_printf ( "helia-bench-%u.ts", i );
+		g_autofree char *path = g_build_filename ( g_get_tmp_dir (), name, NULL );
+
+		GstElement *recmux = NULL, *recsink = NULL;
+		GstElement *recbin = dvb_rec_create_bin ( path, REC_REMUX, sid, NULL, &recmux, &recsink );
+
+		if ( !recbin ) continue;
+
+		gst_bin_add ( GST_BIN ( pipeline ), recbin );
+		gst_element_link ( tee, recbin );
+	}
+
+	double cpu = bench_cpu ();
+
+	bench_run ( pipeline, bench );
+
+	cpu = bench_cpu () - cpu;
+
+	gst_object_unref ( pipeline );
+
+	for ( i = 0; i < branches; i++ )
+	{
+		g_autofree char *name = g_strdup_printf ( "helia-bench-%u.ts", i );
+		g_autofree char *path = g_build_filename ( g_get_tmp_dir (), name, NULL );
+
+		g_unlink ( path );
+	}
+
+	return cpu;
+}
+
+static int bench_record ( Bench *bench )
+{
+	uint n = 0, max = ( bench->num ) ? bench->num : 3;
+
+	double base = bench_record_run ( bench, 0 );
+
+	GArray *runs = g_array_new ( FALSE, FALSE, sizeof ( double ) );
+
+	for ( n = 1; n <= max; n++ )
+	{
+		double per = ( bench_record_run ( bench, n ) - base ) / n;
+
+		g_array_append_val ( runs, per );
+	}
+
+	g_string_append_printf ( bench->result, "\"sid\": %u, \"mode\": \"remux\", \"base_cpu_ms\": %.3f", g_array_index ( bench->sids, uint16_t, 0 ), base );
+
+	bench_json_runs ( bench->result, "cpu_ms_per_branch", runs );
+
+	g_array_free ( runs, TRUE );
+
+	return bench_write ( bench );
+}
+
+/* The first buffer after a new stream-start: buffers queued before a fast zap do not count */
+static GstPadProbeReturn bench_first_frame ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, Bench *bench )
+{
+	if ( !bench->wait ) return GST_PAD_PROBE_OK;
+
+	if ( info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM )
+	{
+		if ( GST_EVENT_TYPE ( gst_pad_probe_info_get_event ( info ) ) == GST_EVENT_STREAM_START ) bench->fresh = TRUE;
+
+		return GST_PAD_PROBE_OK;
+	}
+
+	if ( !bench->fresh ) return GST_PAD_PROBE_OK;
+
+	bench->wait = FALSE;
+
+	double ms = bench_ms ( g_get_monotonic_time () - bench->time );
+	g_array_append_val ( bench->runs, ms );
+
+	g_main_loop_quit ( bench->loop );
+
+	return GST_PAD_PROBE_OK;
+}
+
+static void bench_element_added ( G_GNUC_UNUSED GstBin *bin, G_GNUC_UNUSED GstBin *sub_bin, GstElement *element, Bench *bench )
+{
+	GstElementFactory *factory = gst_element_get_factory ( element );
+
+	if ( !factory || !g_str_equal ( GST_OBJECT_NAME ( factory ), "autovideosink" ) ) return;
+
+	GstPad *pad = gst_element_get_static_pad ( element, "sink" );
+
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback)bench_first_frame, bench, NULL );
+
+	gst_object_unref ( pad );
+}
+
+static gboolean bench_zap_timeout ( Bench *bench )
+{
+	if ( bench->wait ) { g_warning ( "%s:: no video buffer in 15 s ", __func__ ); bench->wait = FALSE; }
+
+	bench->src_tm = 0;
+
+	g_main_loop_quit ( bench->loop );
+
+	return G_SOURCE_REMOVE;
+}
+
+static void bench_zap_run ( Bench *bench, Dvb *dvb, const char *data, gboolean stop )
+{
+	if ( stop ) g_signal_emit_by_name ( dvb, "dvb-stop" );
+
+	bench->wait  = TRUE;
+	bench->fresh = FALSE;
+	bench->time  = g_get_monotonic_time ();
+
+	g_signal_emit_by_name ( dvb, "dvb-play", data );
+
+	bench->src_tm = g_timeout_add_seconds ( 15, (GSourceFunc)bench_zap_timeout, bench );
+
+	g_main_loop_run ( bench->loop );
+
+	if ( bench->src_tm ) g_source_remove ( bench->src_tm );
+	bench->src_tm = 0;
+}
+
+/* Zaps through the player of dvb.c: cold ( stop, then play ) and fast ( same transponder, dvb_zap ) */
+static int bench_zap ( Bench *bench )
+{
+	if ( !gtk_init_check ( NULL, NULL ) ) { fprintf ( stderr, "zap: no display.\n" ); return BENCH_SKIP; }
+
+	uint i = 0, num = ( bench->num ) ? bench->num : 5;
+
+	GtkWindow *window = (GtkWindow *)gtk_window_new ( GTK_WINDOW_TOPLEVEL );
+	gtk_window_set_default_size ( window, 320, 180 );
+
+	Dvb *dvb = dvb_new ( 0, NULL );
+	gtk_container_add ( GTK_CONTAINER ( window ), GTK_WIDGET ( dvb ) );
+	gtk_widget_show_all ( GTK_WIDGET ( window ) );
+
+	while ( gtk_events_pending () ) gtk_main_iteration ();
+
+	GstElement *pipeline = NULL;
+	g_signal_emit_by_name ( dvb, "dvb-get-pipeline", &pipeline );
+
+	g_signal_connect ( pipeline, "deep-element-added", G_CALLBACK ( bench_element_added ), bench );
+
+	GArray *cold = g_array_new ( FALSE, FALSE, sizeof ( double ) );
+	GArray *fast = g_array_new ( FALSE, FALSE, sizeof ( double ) );
+
+	bench->runs = cold;
+
+	for ( i = 0; i < num; i++ )
+	{
+		g_autofree char *data = bench_chan_data ( g_array_index ( bench->sids, uint16_t, i % bench->sids->len ) );
+
+		bench_zap_run ( bench, dvb, data, TRUE );
+	}
+
+	/* All programs of the file share one transponder: playing another sid without a stop takes the fast path */
+	bench->runs = fast;
+
+	for ( i = 0; i < num && bench->sids->len > 1; i++ )
+	{
+		g_autofree char *data = bench_chan_data ( g_array_index ( bench->sids, uint16_t, ( num + i ) % bench->sids->len ) );
+
+		bench_zap_run ( bench, dvb, data, FALSE );
+	}
+
+	g_signal_emit_by_name ( dvb, "dvb-stop" );
+
+	gtk_widget_destroy ( GTK_WIDGET ( window ) );
+
+	g_string_append_printf ( bench->result, "\"zaps\": %u", num );
+
+	bench_json_runs ( bench->result, "first_frame_ms", cold );
+	bench_json_runs ( bench->result, "fast_zap_ms", fast );
+
+	g_array_free ( cold, TRUE );
+	g_array_free ( fast, TRUE );
+
+	return bench_write ( bench );
+}
+
+int main ( int argc, char **argv )
+{
+	Bench bench = { 0 };
+
+	const char *ts = NULL, *json = NULL;
+	int num = 0;
+
+	GOptionEntry entries[] =
+	{
+		{ "ts",   0, 0, G_OPTION_ARG_FILENAME, &ts,   "Captured transponder", "FILE" },
+		{ "json", 0, 0, G_OPTION_ARG_FILENAME, &json, "Write the result to",  "FILE" },
+		{ "num",  0, 0, G_OPTION_ARG_INT,      &num,  "Lines, views, branches or zaps", "N" },
+		{ NULL }
+	};
+
+	GOptionContext *context = g_option_context_new ( "load | demux | record | zap" );
+	g_option_context_add_main_entries ( context, entries, NULL );
+
+	if ( !g_option_context_parse ( context, &argc, &argv, NULL ) || argc != 2 )
+	{
+		fprintf ( stderr, "%s", g_option_context_get_help ( context, TRUE, NULL ) );
+		g_option_context_free ( context );
+
+		return 1;
+	}
+
+	g_option_context_free ( context );
+
+	gst_init ( NULL, NULL );
+
+	bench.name   = argv[1];
+	bench.ts     = ( ts && ts[0] ) ? ts : NULL;
+	bench.json   = json;
+	bench.num    = ( num > 0 ) ? (uint)num : 0;
+	bench.result = g_string_new ( NULL );
+	bench.loop   = g_main_loop_new ( NULL, FALSE );
+
+	if ( g_str_equal ( bench.name, "load" ) ) return bench_load ( &bench );
+
+	if ( !bench.ts ) { fprintf ( stderr, "%s: no TS file ( --ts ).\n", bench.name ); return BENCH_SKIP; }
+
+	g_setenv ( "HELIA_TS_FILE", bench.ts, TRUE );
+	g_setenv ( "HELIA_TS_PACE", "fast", TRUE );
+
+	bench_get_sids ( &bench );
+
+	if ( !bench.sids->len ) { fprintf ( stderr, "%s: no programs in %s.\n", bench.name, bench.ts ); return BENCH_SKIP; }
+
+	/* Zap waits for the PCR pace like a tuner would deliver it */
+	if ( g_str_equal ( bench.name, "zap" ) ) { g_unsetenv ( "HELIA_TS_PACE" ); return bench_zap ( &bench ); }
+
+	if ( g_str_equal ( bench.name, "demux"  ) ) return bench_demux  ( &bench );
+	if ( g_str_equal ( bench.name, "record" ) ) return bench_record ( &bench );
+
+	fprintf ( stderr, "Unknown benchmark: %s\n", bench.name );
+
+	return 1;
+}
@@ -0,0 +1,167 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "chan-find.h"
+#include "descr.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TRI(s) GUINT_TO_POINTER ( ( (uint)(uint8_t)(s)[0] << 16 ) | ( (uint)(uint8_t)(s)[1] << 8 ) | (uint)(uint8_t)(s)[2] )
+
+typedef struct _ChanKey ChanKey;
+
+struct _ChanKey
+{
+	const DvbChan *chan;
+
+	char *text;
+	uint refs;
+};
+
+struct _ChanFind
+{
+	/* DvbChan -> ChanKey: lowercase "name delivery-system" and row count; a key holds a record reference */
+	GHashTable *keys;
+
+	/* Trigram -> GPtrArray of DvbChan, each record once */
+	GHashTable *tris;
+};
+
+static void chan_find_key_free ( ChanKey *key )
+{
+	dvb_chan_unref ( key->chan );
+
+	free ( key->text );
+	free ( key );
+}
+
+ChanFind * chan_find_new ( void )
+{
+	ChanFind *find = g_new0 ( ChanFind, 1 );
+
+	find->keys = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)chan_find_key_free );
+	find->tris = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_ptr_array_unref );
+
+	return find;
+}
+
+static char * chan_find_text ( const DvbChan *chan )
+{
+	const DvbChanProp *prop = dvb_chan_find ( chan, "delsys" );
+
+	const char *delsys = ( prop ) ? descr_get_delsys_name ( (uint)prop->num ) : NULL;
+
+	g_autofree char *text = g_strconcat ( chan->name, " ", ( delsys ) ? delsys : "", NULL );
+
+	return g_utf8_strdown ( text, -1 );
+}
+
+void chan_find_add ( ChanFind *find, const DvbChan *chan )
+{
+	ChanKey *key = g_hash_table_lookup ( find->keys, chan );
+
+	if ( key ) { key->refs++; return; }
+
+	key = g_new0 ( ChanKey, 1 );
+	key->chan = chan;
+	key->text = chan_find_text ( chan );
+	key->refs = 1;
+
+	dvb_chan_ref ( chan );
+
+	g_hash_table_insert ( find->keys, (gpointer)chan, key );
+
+	size_t i = 0, len = strlen ( key->text );
+
+	for ( i = 0; i + 3 <= len; i++ )
+	{
+		GPtrArray *list = g_hash_table_lookup ( find->tris, TRI ( key->text + i ) );
+
+		if ( !list ) { list = g_ptr_array_new (); g_hash_table_insert ( find->tris, TRI ( key->text + i ), list ); }
+
+		/* All trigrams of one record are added together, so a repeat ends the list */
+		if ( list->len && g_ptr_array_index ( list, list->len - 1 ) == chan ) continue;
+
+		g_ptr_array_add ( list, (gpointer)chan );
+	}
+}
+
+void chan_find_remove ( ChanFind *find, const DvbChan *chan )
+{
+	ChanKey *key = g_hash_table_lookup ( find->keys, chan );
+
+	/* Postings are left in place and skipped while the record is unused */
+	if ( key && key->refs ) key->refs--;
+}
+
+void chan_find_clear ( ChanFind *find )
+{
+	g_hash_table_remove_all ( find->keys );
+	g_hash_table_remove_all ( find->tris );
+}
+
+static void chan_find_match ( const DvbChan *chan, ChanKey *key, const char *text, GPtrArray *ret )
+{
+	if ( key->refs && strstr ( key->text, text ) ) g_ptr_array_add ( ret, (gpointer)chan );
+}
+
+/* Matching records, each once and unordered; NULL for an empty query */
+GPtrArray * chan_find_query ( ChanFind *find, const char *query )
+{
+	g_autofree char *text = g_utf8_strdown ( query, -1 );
+
+	g_strstrip ( text );
+
+	if ( text[0] == '\0' ) return NULL;
+
+	GPtrArray *ret = g_ptr_array_new ();
+
+	size_t i = 0, len = strlen ( text );
+
+	if ( len < 3 )
+	{
+		GHashTableIter iter;
+		gpointer chan, key;
+
+		g_hash_table_iter_init ( &iter, find->keys );
+
+		while ( g_hash_table_iter_next ( &iter, &chan, &key ) ) chan_find_match ( chan, key, text, ret );
+
+		return ret;
+	}
+
+	GPtrArray *best = NULL;
+
+	for ( i = 0; i + 3 <= len; i++ )
+	{
+		GPtrArray *list = g_hash_table_lookup ( find->tris, TRI ( text + i ) );
+
+		if ( !list ) return ret;
+
+		if ( !best || list->len < best->len ) best = list;
+	}
+
+	for ( i = 0; i < best->len; i++ )
+	{
+		const DvbChan *chan = g_ptr_array_index ( best, i );
+
+		chan_find_match ( chan, g_hash_table_lookup ( find->keys, chan ), text, ret );
+	}
+
+	return ret;
+}
+
+void chan_find_free ( ChanFind *find )
+{
+	g_hash_table_unref ( find->tris );
+	g_hash_table_unref ( find->keys );
+
+	free ( find );
+}
@@ -0,0 +1,26 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include "dvb-tune.h"
+
+typedef struct _ChanFind ChanFind;
+
+ChanFind * chan_find_new ( void );
+
+void chan_find_add ( ChanFind *, const DvbChan * );
+
+void chan_find_remove ( ChanFind *, const DvbChan * );
+
+void chan_find_clear ( ChanFind * );
+
+GPtrArray * chan_find_query ( ChanFind *, const char * );
+
+void chan_find_free ( ChanFind * );
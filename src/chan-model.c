@@ -0,0 +1,310 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "chan-model.h"
+#include "chan-find.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct _ChanModel
+{
+	GObject parent_instance;
+
+	GPtrArray *chans;
+	ChanFind *find;
+
+	int stamp;
+};
+
+static void chan_model_tree_init ( GtkTreeModelIface * );
+
+G_DEFINE_TYPE_WITH_CODE ( ChanModel, chan_model, G_TYPE_OBJECT, G_IMPLEMENT_INTERFACE ( GTK_TYPE_TREE_MODEL, chan_model_tree_init ) )
+
+static gboolean chan_model_set_iter ( ChanModel *model, GtkTreeIter *iter, uint index )
+{
+	if ( index >= model->chans->len ) { iter->stamp = 0; return FALSE; }
+
+	iter->stamp = model->stamp;
+	iter->user_data = GUINT_TO_POINTER ( index );
+
+	return TRUE;
+}
+
+uint chan_model_iter_index ( GtkTreeIter *iter )
+{
+	return GPOINTER_TO_UINT ( iter->user_data );
+}
+
+static GtkTreeModelFlags chan_model_get_flags ( G_GNUC_UNUSED GtkTreeModel *tree_model )
+{
+	return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static int chan_model_get_n_columns ( G_GNUC_UNUSED GtkTreeModel *tree_model )
+{
+	return NUM_COLS;
+}
+
+static GType chan_model_get_column_type ( G_GNUC_UNUSED GtkTreeModel *tree_model, int index )
+{
+	return ( index == COL_NUM ) ? G_TYPE_UINT : G_TYPE_STRING;
+}
+
+static gboolean chan_model_get_iter ( GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path )
+{
+	if ( gtk_tree_path_get_depth ( path ) != 1 ) return FALSE;
+
+	return chan_model_set_iter ( CHAN_MODEL ( tree_model ), iter, (uint)gtk_tree_path_get_indices ( path )[0] );
+}
+
+static GtkTreePath * chan_model_get_path ( G_GNUC_UNUSED GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	return gtk_tree_path_new_from_indices ( (int)chan_model_iter_index ( iter ), -1 );
+}
+
+static void chan_model_get_value ( GtkTreeModel *tree_model, GtkTreeIter *iter, int column, GValue *value )
+{
+	uint index = chan_model_iter_index ( iter );
+
+	const DvbChan *chan = chan_model_get ( CHAN_MODEL ( tree_model ), index );
+
+	g_value_init ( value, chan_model_get_column_type ( tree_model, column ) );
+
+	if ( !chan ) return;
+
+	/* Row numbers follow the position, so nothing is renumbered on move or remove */
+	if ( column == COL_NUM  ) g_value_set_uint ( value, index + 1 );
+	if ( column == COL_FLCH ) g_value_set_static_string ( value, chan->name );
+	if ( column == COL_DATA ) g_value_set_static_string ( value, chan->data );
+}
+
+static gboolean chan_model_iter_next ( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	return chan_model_set_iter ( CHAN_MODEL ( tree_model ), iter, chan_model_iter_index ( iter ) + 1 );
+}
+
+static gboolean chan_model_iter_previous ( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	uint index = chan_model_iter_index ( iter );
+
+	if ( index == 0 ) { iter->stamp = 0; return FALSE; }
+
+	return chan_model_set_iter ( CHAN_MODEL ( tree_model ), iter, index - 1 );
+}
+
+static gboolean chan_model_iter_nth_child ( GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, int n )
+{
+	if ( parent || n < 0 ) { iter->stamp = 0; return FALSE; }
+
+	return chan_model_set_iter ( CHAN_MODEL ( tree_model ), iter, (uint)n );
+}
+
+static gboolean chan_model_iter_children ( GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent )
+{
+	return chan_model_iter_nth_child ( tree_model, iter, parent, 0 );
+}
+
+static gboolean chan_model_iter_has_child ( G_GNUC_UNUSED GtkTreeModel *tree_model, G_GNUC_UNUSED GtkTreeIter *iter )
+{
+	return FALSE;
+}
+
+static int chan_model_iter_n_children ( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	return ( iter ) ? 0 : (int)CHAN_MODEL ( tree_model )->chans->len;
+}
+
+static gboolean chan_model_iter_parent ( G_GNUC_UNUSED GtkTreeModel *tree_model, GtkTreeIter *iter, G_GNUC_UNUSED GtkTreeIter *child )
+{
+	iter->stamp = 0;
+
+	return FALSE;
+}
+
+static void chan_model_tree_init ( GtkTreeModelIface *iface )
+{
+	iface->get_flags       = chan_model_get_flags;
+	iface->get_n_columns   = chan_model_get_n_columns;
+	iface->get_column_type = chan_model_get_column_type;
+	iface->get_iter        = chan_model_get_iter;
+	iface->get_path        = chan_model_get_path;
+	iface->get_value       = chan_model_get_value;
+	iface->iter_next       = chan_model_iter_next;
+	iface->iter_previous   = chan_model_iter_previous;
+	iface->iter_children   = chan_model_iter_children;
+	iface->iter_has_child  = chan_model_iter_has_child;
+	iface->iter_n_children = chan_model_iter_n_children;
+	iface->iter_nth_child  = chan_model_iter_nth_child;
+	iface->iter_parent     = chan_model_iter_parent;
+}
+
+uint chan_model_get_n ( ChanModel *model )
+{
+	return model->chans->len;
+}
+
+const DvbChan * chan_model_get ( ChanModel *model, uint index )
+{
+	return ( index < model->chans->len ) ? g_ptr_array_index ( model->chans, index ) : NULL;
+}
+
+void chan_model_append ( ChanModel *model, const DvbChan *chan )
+{
+	dvb_chan_ref ( chan );
+
+	g_ptr_array_add ( model->chans, (gpointer)chan );
+
+	if ( model->find ) chan_find_add ( model->find, chan );
+
+	GtkTreeIter iter;
+	chan_model_set_iter ( model, &iter, model->chans->len - 1 );
+
+	GtkTreePath *path = gtk_tree_path_new_from_indices ( (int)model->chans->len - 1, -1 );
+
+	gtk_tree_model_row_inserted ( GTK_TREE_MODEL ( model ), path, &iter );
+
+	gtk_tree_path_free ( path );
+}
+
+/* Appends up to max channel lines from *pos, skipping comments; TRUE while text is left */
+gboolean chan_model_load ( ChanModel *model, const char **pos, const char *end, uint max )
+{
+	uint n = 0;
+
+	while ( *pos < end && n < max )
+	{
+		const char *eol = memchr ( *pos, '\n', (size_t)( end - *pos ) );
+		if ( !eol ) eol = end;
+
+		size_t len = (size_t)( eol - *pos );
+
+		if ( len >= 2 && (*pos)[0] != '#' )
+		{
+			char *line = g_strndup ( *pos, len );
+
+			chan_model_append ( model, dvb_chan_get ( line ) );
+
+			free ( line );
+			n++;
+		}
+
+		*pos = eol + 1;
+	}
+
+	return ( *pos < end );
+}
+
+void chan_model_remove ( ChanModel *model, uint index )
+{
+	if ( index >= model->chans->len ) return;
+
+	const DvbChan *chan = g_ptr_array_index ( model->chans, index );
+
+	if ( model->find ) chan_find_remove ( model->find, chan );
+
+	g_ptr_array_remove_index ( model->chans, index );
+
+	model->stamp++;
+
+	GtkTreePath *path = gtk_tree_path_new_from_indices ( (int)index, -1 );
+
+	gtk_tree_model_row_deleted ( GTK_TREE_MODEL ( model ), path );
+
+	gtk_tree_path_free ( path );
+}
+
+static void chan_model_changed ( ChanModel *model, uint index )
+{
+	GtkTreeIter iter;
+	chan_model_set_iter ( model, &iter, index );
+
+	GtkTreePath *path = gtk_tree_path_new_from_indices ( (int)index, -1 );
+
+	gtk_tree_model_row_changed ( GTK_TREE_MODEL ( model ), path, &iter );
+
+	gtk_tree_path_free ( path );
+}
+
+void chan_model_swap ( ChanModel *model, uint a, uint b )
+{
+	if ( a >= model->chans->len || b >= model->chans->len || a == b ) return;
+
+	gpointer tmp = model->chans->pdata[a];
+	model->chans->pdata[a] = model->chans->pdata[b];
+	model->chans->pdata[b] = tmp;
+
+	chan_model_changed ( model, a );
+	chan_model_changed ( model, b );
+}
+
+void chan_model_clear ( ChanModel *model )
+{
+	while ( model->chans->len ) chan_model_remove ( model, model->chans->len - 1 );
+
+	if ( model->find ) chan_find_clear ( model->find );
+}
+
+ChanModel * chan_model_filter ( ChanModel *model, const char *text )
+{
+	if ( !model->find ) return NULL;
+
+	g_autoptr ( GPtrArray ) found = chan_find_query ( model->find, text );
+
+	if ( !found ) return NULL;
+
+	ChanModel *ret = g_object_new ( CHAN_TYPE_MODEL, NULL );
+
+	if ( !found->len ) return ret;
+
+	/* Hits are records in no particular order: rows keep the list order and duplicates */
+	g_autoptr ( GHashTable ) hits = g_hash_table_new ( g_direct_hash, g_direct_equal );
+
+	uint i = 0; for ( i = 0; i < found->len; i++ ) g_hash_table_add ( hits, g_ptr_array_index ( found, i ) );
+
+	for ( i = 0; i < model->chans->len; i++ )
+	{
+		const DvbChan *chan = g_ptr_array_index ( model->chans, i );
+
+		if ( g_hash_table_contains ( hits, chan ) ) chan_model_append ( ret, chan );
+	}
+
+	return ret;
+}
+
+static void chan_model_init ( ChanModel *model )
+{
+	model->chans = g_ptr_array_new_with_free_func ( (GDestroyNotify)dvb_chan_unref );
+	model->stamp = (int)g_random_int ();
+}
+
+static void chan_model_finalize ( GObject *object )
+{
+	ChanModel *model = CHAN_MODEL ( object );
+
+	g_ptr_array_free ( model->chans, TRUE );
+
+	if ( model->find ) chan_find_free ( model->find );
+
+	G_OBJECT_CLASS ( chan_model_parent_class )->finalize ( object );
+}
+
+static void chan_model_class_init ( ChanModelClass *class )
+{
+	G_OBJECT_CLASS ( class )->finalize = chan_model_finalize;
+}
+
+ChanModel * chan_model_new ( void )
+{
+	ChanModel *model = g_object_new ( CHAN_TYPE_MODEL, NULL );
+
+	model->find = chan_find_new ();
+
+	return model;
+}
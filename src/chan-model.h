@@ -0,0 +1,48 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include "dvb-tune.h"
+
+#include <gtk/gtk.h>
+
+#define CHAN_LOAD_BATCH 2000
+
+enum cols_n
+{
+	COL_NUM,
+	COL_FLCH,
+	COL_DATA,
+	NUM_COLS
+};
+
+#define CHAN_TYPE_MODEL chan_model_get_type ()
+
+G_DECLARE_FINAL_TYPE ( ChanModel, chan_model, CHAN, MODEL, GObject )
+
+ChanModel * chan_model_new ( void );
+
+uint chan_model_get_n ( ChanModel * );
+
+const DvbChan * chan_model_get ( ChanModel *, uint );
+
+void chan_model_append ( ChanModel *, const DvbChan * );
+
+gboolean chan_model_load ( ChanModel *, const char **, const char *, uint );
+
+void chan_model_remove ( ChanModel *, uint );
+
+void chan_model_swap ( ChanModel *, uint, uint );
+
+void chan_model_clear ( ChanModel * );
+
+ChanModel * chan_model_filter ( ChanModel *, const char * );
+
+uint chan_model_iter_index ( GtkTreeIter * );
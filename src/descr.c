@@ -9,6 +9,7 @@
 
 #include "descr.h"
 #include "scan.h"
+#include "dvb-tune.h"
 
 #include <stdlib.h>
 #include <gst/gst.h>
@@ -705,46 +706,40 @@ static GtkLabel * descr_info_create_label ( const char *text )
 	return label;
 }
 
-static void descr_info_set_data ( uint sid, const char *data, const DvbTypes *dvball, uint num, uint delsys, GtkBox *v_box, GtkComboBoxText *combo_lang )
+static void descr_info_set_data ( uint sid, const DvbChan *chan, const DvbTypes *dvball, uint num, uint delsys, GtkBox *v_box, GtkComboBoxText *combo_lang )
 {
 	GtkGrid *grid = (GtkGrid *)gtk_grid_new();
 	gtk_grid_set_row_spacing ( grid, 5 );
 	gtk_grid_set_column_homogeneous ( grid, TRUE );
 	gtk_widget_set_visible ( GTK_WIDGET ( grid  ), TRUE );
 
-	char **line = g_strsplit ( data, ":", 0 );
-	uint c = 0, d = 0, z = 0, j = 0, n = 0, n_splits = g_strv_length ( line );
+	uint c = 0, d = 0, z = 0, j = 0, n = 0;
 
 	GtkEntry *entry_ch = (GtkEntry *) gtk_entry_new ();
 	g_object_set ( entry_ch, "editable", FALSE, NULL );
-	gtk_entry_set_text ( entry_ch, line[0] );
+	gtk_entry_set_text ( entry_ch, chan->name );
 	gtk_widget_set_visible ( GTK_WIDGET ( entry_ch  ), TRUE );
 	gtk_box_pack_start ( v_box, GTK_WIDGET ( entry_ch ), FALSE, FALSE, 0 );
 
 	gboolean visible_combo = FALSE;
 	gtk_box_pack_start ( v_box, GTK_WIDGET ( combo_lang ), FALSE, FALSE, 0 );
 
-	for ( j = 1; j < n_splits; j++ )
+	for ( j = 0; j < chan->n_props; j++ )
 	{
 		const char *data_1[] = { "Service Id", "Audio Pid", "Video Pid" };
 		const char *data_2[] = { "program-number", "audio-pid", "video-pid" };
 
 		uint8_t f = 0; for ( f = 0; f < G_N_ELEMENTS ( data_1 ); f++ )
 		{
-			if ( g_strrstr ( line[j], data_2[f] ) )
+			if ( g_str_equal ( chan->props[j].key, data_2[f] ) )
 			{
 				GtkLabel *label = descr_info_create_label ( data_1[f] );
 				gtk_grid_attach ( grid, GTK_WIDGET ( label ), 0, (int)n, 1, 1 );
 
-				char **splits = g_strsplit ( line[j], "=", 0 );
-
-				label = descr_info_create_label ( splits[1] );
+				label = descr_info_create_label ( chan->props[j].value );
 				gtk_grid_attach ( grid, GTK_WIDGET ( label ), 1, (int)n++, 1, 1 );
 
-				uint pn = ( uint ) atoi ( splits[1] );
-				if ( f == 0 && pn == sid ) visible_combo = TRUE;
-
-		 		g_strfreev ( splits );
+				if ( f == 0 && (uint)chan->props[j].num == sid ) visible_combo = TRUE;
 
 				break;
 			}
@@ -757,8 +752,6 @@ static void descr_info_set_data ( uint sid, const char *data, const DvbTypes *dv
 	{
 		gtk_box_pack_start ( v_box, GTK_WIDGET ( grid ), TRUE, TRUE, 0 );
 
-		g_strfreev ( line );
-
 		return;
 	}
 
@@ -767,20 +760,18 @@ static void descr_info_set_data ( uint sid, const char *data, const DvbTypes *dv
 		GtkLabel *label = descr_info_create_label ( dvball[c].name );
 		gtk_grid_attach ( grid, GTK_WIDGET ( label ), 0, (int)( c + n ), 1, 1 );
 
-		for ( j = 1; j < n_splits; j++ )
-		{
-			if ( !g_strrstr ( line[j], dvball[c].gst_prop ) ) continue;
-
-			char **splits = g_strsplit ( line[j], "=", 0 );
+		const DvbChanProp *prop = dvb_chan_find ( chan, dvball[c].gst_prop );
 
-			GtkLabel *label_set = descr_info_create_label ( splits[1] );
+		if ( prop )
+		{
+			GtkLabel *label_set = descr_info_create_label ( prop->value );
 			gtk_grid_attach ( grid, GTK_WIDGET ( label_set ), 1, (int)( c + n ), 1, 1 );
 
-			long dat = atol ( splits[1] );
+			long dat = prop->num;
 
 			if ( !dvball[c].descr )
 			{
-				if ( g_str_has_prefix ( splits[0], "frequency" ) )
+				if ( g_str_has_prefix ( prop->key, "frequency" ) )
 				{
 					if ( delsys == SYS_DVBS || delsys == SYS_DVBS2 || delsys == SYS_TURBO )
 						dat = dat / 1000;
@@ -793,7 +784,7 @@ static void descr_info_set_data ( uint sid, const char *data, const DvbTypes *dv
 					gtk_label_set_text ( label_set, buf );
 				}
 
-				if ( g_str_has_prefix ( splits[0], "symbol-rate" ) && dat > 1000000 )
+				if ( g_str_has_prefix ( prop->key, "symbol-rate" ) && dat > 1000000 )
 				{
 					dat = dat / 1000;
 
@@ -810,7 +801,7 @@ static void descr_info_set_data ( uint sid, const char *data, const DvbTypes *dv
 				{
 					if ( dvball[c].descr == POL )
 					{
-						if ( splits[1][0] == 'v' || splits[1][0] == 'V' || splits[1][0] == '0' )
+						if ( prop->value[0] == 'v' || prop->value[0] == 'V' || prop->value[0] == '0' )
 							gtk_label_set_text ( label_set, "V" );
 						else
 							gtk_label_set_text ( label_set, "H" );
@@ -826,27 +817,24 @@ static void descr_info_set_data ( uint sid, const char *data, const DvbTypes *dv
 				}
 			}
 
-			g_debug ( "%s: %s -- %s", __func__, dvball[c].name, line[j] );
-
-			g_strfreev ( splits );
+			g_debug ( "%s: %s -- %s", __func__, dvball[c].name, prop->value );
 		}
 	}
 
-	g_strfreev ( line );
-
 	gtk_box_pack_start ( v_box, GTK_WIDGET ( grid ), TRUE, TRUE, 0 );
 }
 
-static uint descr_info_get_delsys ( const char *data )
+static uint descr_info_get_delsys ( const DvbChan *chan )
 {
 	uint ret = SYS_UNDEFINED, d = 0;
 
+	const DvbChanProp *prop = dvb_chan_find ( chan, "delsys" );
+
+	if ( !prop ) return ret;
+
 	for ( d = 0; d < G_N_ELEMENTS ( dvb_descr_delsys_type_n ); d++ )
 	{
-		char delsys_prop[25];
-		sprintf ( delsys_prop, "delsys=%d", dvb_descr_delsys_type_n[d].descr );
-
-		if ( g_strrstr ( data, delsys_prop ) )
+		if ( prop->num == dvb_descr_delsys_type_n[d].descr )
 		{
 			ret = (uint)dvb_descr_delsys_type_n[d].descr;
 
@@ -859,20 +847,30 @@ static uint descr_info_get_delsys ( const char *data )
 	return ret;
 }
 
+const char * descr_get_delsys_name ( uint delsys )
+{
+	uint d = 0; for ( d = 0; d < G_N_ELEMENTS ( dvb_descr_delsys_type_n ); d++ )
+		if ( (uint)dvb_descr_delsys_type_n[d].descr == delsys ) return dvb_descr_delsys_type_n[d].text;
+
+	return NULL;
+}
+
 static void descr_handler_info ( G_GNUC_UNUSED Descr *descr, uint sid, const char *data, GObject *obj_box, GObject *obj_combo )
 {
 	GtkBox *v_box = GTK_BOX ( obj_box );
 	GtkComboBoxText *combo_lang = GTK_COMBO_BOX_TEXT ( obj_combo );
 
-	uint delsys = descr_info_get_delsys ( data );
+	const DvbChan *chan = dvb_chan_get ( data );
+
+	uint delsys = descr_info_get_delsys ( chan );
 
-	if ( delsys == SYS_UNDEFINED )                                          descr_info_set_data ( sid, data, NULL, 0, delsys, v_box, combo_lang );
+	if ( delsys == SYS_UNDEFINED )                                          descr_info_set_data ( sid, chan, NULL, 0, delsys, v_box, combo_lang );
 
-	if ( delsys == SYS_DTMB )                                               descr_info_set_data ( sid, data, atsc_props_n, G_N_ELEMENTS ( atsc_props_n ), delsys, v_box, combo_lang );
-	if ( delsys == SYS_DVBT || delsys == SYS_DVBT2 )                        descr_info_set_data ( sid, data, dvbt_props_n, G_N_ELEMENTS ( dvbt_props_n ), delsys, v_box, combo_lang );
-	if ( delsys == SYS_ATSC || delsys == SYS_DVBC_ANNEX_B )                 descr_info_set_data ( sid, data, dtmb_props_n, G_N_ELEMENTS ( dtmb_props_n ), delsys, v_box, combo_lang );
-	if ( delsys == SYS_DVBC_ANNEX_A || delsys == SYS_DVBC_ANNEX_C )         descr_info_set_data ( sid, data, dvbc_props_n, G_N_ELEMENTS ( dvbc_props_n ), delsys, v_box, combo_lang );
-	if ( delsys == SYS_DVBS || delsys == SYS_DVBS2 || delsys == SYS_TURBO ) descr_info_set_data ( sid, data, dvbs_props_n, G_N_ELEMENTS ( dvbs_props_n ), delsys, v_box, combo_lang );
+	if ( delsys == SYS_DTMB )                                               descr_info_set_data ( sid, chan, atsc_props_n, G_N_ELEMENTS ( atsc_props_n ), delsys, v_box, combo_lang );
+	if ( delsys == SYS_DVBT || delsys == SYS_DVBT2 )                        descr_info_set_data ( sid, chan, dvbt_props_n, G_N_ELEMENTS ( dvbt_props_n ), delsys, v_box, combo_lang );
+	if ( delsys == SYS_ATSC || delsys == SYS_DVBC_ANNEX_B )                 descr_info_set_data ( sid, chan, dtmb_props_n, G_N_ELEMENTS ( dtmb_props_n ), delsys, v_box, combo_lang );
+	if ( delsys == SYS_DVBC_ANNEX_A || delsys == SYS_DVBC_ANNEX_C )         descr_info_set_data ( sid, chan, dvbc_props_n, G_N_ELEMENTS ( dvbc_props_n ), delsys, v_box, combo_lang );
+	if ( delsys == SYS_DVBS || delsys == SYS_DVBS2 || delsys == SYS_TURBO ) descr_info_set_data ( sid, chan, dvbs_props_n, G_N_ELEMENTS ( dvbs_props_n ), delsys, v_box, combo_lang );
 }
 
 static void descr_init ( Descr *descr )
@@ -18,3 +18,5 @@ typedef unsigned int uint;
 G_DECLARE_FINAL_TYPE ( Descr, descr, DESCR, OBJECT, GObject )
 
 Descr * descr_new ( void );
+
+const char * descr_get_delsys_name ( uint );
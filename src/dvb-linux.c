@@ -52,3 +52,29 @@ inline char * dvb_get_name ( int adapter, int frontend )
 
 	return name;
 }
+
+uint32_t dvb_get_delsys ( int adapter, int frontend )
+{
+	uint32_t mask = 0;
+
+	char path[80];
+	sprintf ( path, "/dev/dvb/adapter%d/frontend%d", adapter, frontend );
+
+	int fd = open ( path, O_RDONLY );
+
+	if ( fd == -1 ) { g_warning ( "%s: %s %s \n", __func__, path, g_strerror ( errno ) ); return 0; }
+
+	struct dtv_property prop = { .cmd = DTV_ENUM_DELSYS };
+	struct dtv_properties props = { .num = 1, .props = &prop };
+
+	if ( ( ioctl ( fd, FE_GET_PROPERTY, &props ) ) == -1 )
+		perror ( "dvb_get_delsys: ioctl FE_GET_PROPERTY " );
+	else
+	{
+		uint32_t c = 0; for ( c = 0; c < prop.u.buffer.len && c < 32; c++ ) if ( prop.u.buffer.data[c] < 32 ) mask |= 1u << prop.u.buffer.data[c];
+	}
+
+	close ( fd );
+
+	return mask;
+}
@@ -13,3 +13,5 @@
 #include <string.h>
 
 char * dvb_get_name ( int, int );
+
+uint32_t dvb_get_delsys ( int, int );
@@ -0,0 +1,231 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "dvb-pool.h"
+#include "dvb-tune.h"
+#include "dvb-linux.h"
+#include "ts-file.h"
+
+#include <stdlib.h>
+
+#define MAX_ADAPTER  16
+#define MAX_FRONTEND 4
+
+struct _DvbTuner
+{
+	int adapter;
+	int frontend;
+
+	char *name;
+	char *tp_key;
+
+	uint32_t delsys;
+	uint users;
+
+	DvbPreempt preempt;
+	gpointer preempt_data;
+};
+
+enum DvbPlayFlags
+{
+	DVB_PLAY_BUSY = 1 << 0,
+	DVB_PLAY_STOP = 1 << 1
+};
+
+static GPtrArray *dvb_pool = NULL;
+static GMutex dvb_pool_mutex;
+static GMutex dvb_play_mutex;
+static GCond  dvb_play_cond;
+
+static void dvb_pool_init ( void )
+{
+	dvb_pool = g_ptr_array_new ();
+
+	/* A replayed file needs no hardware: one tuner that fits any delivery system */
+	if ( ts_file_active () )
+	{
+		DvbTuner *tuner = g_new0 ( DvbTuner, 1 );
+		tuner->name = g_strdup ( "TS file" );
+
+		g_ptr_array_add ( dvb_pool, tuner );
+
+		return;
+	}
+
+	int a = 0, f = 0;
+
+	for ( a = 0; a < MAX_ADAPTER; a++ )
+	for ( f = 0; f < MAX_FRONTEND; f++ )
+	{
+		char path[80];
+		sprintf ( path, "/dev/dvb/adapter%d/frontend%d", a, f );
+
+		if ( !g_file_test ( path, G_FILE_TEST_EXISTS ) ) continue;
+
+		DvbTuner *tuner = g_new0 ( DvbTuner, 1 );
+
+		tuner->adapter  = a;
+		tuner->frontend = f;
+		tuner->name   = dvb_get_name ( a, f );
+		tuner->delsys = dvb_get_delsys ( a, f );
+
+		g_ptr_array_add ( dvb_pool, tuner );
+
+		g_debug ( "%s:: %s: adapter %d, frontend %d ", __func__, tuner->name, a, f );
+	}
+}
+
+static gboolean dvb_pool_fit_delsys ( DvbTuner *tuner, uint delsys )
+{
+	return ( !tuner->delsys || delsys >= 32 || ( tuner->delsys & ( 1u << delsys ) ) );
+}
+
+static gboolean dvb_pool_fit ( DvbTuner *tuner, uint delsys )
+{
+	if ( tuner->users ) return FALSE;
+
+	return dvb_pool_fit_delsys ( tuner, delsys );
+}
+
+static DvbTuner * dvb_pool_take ( const char *data, DvbPreempt preempt, gpointer preempt_data )
+{
+	g_autofree char *tp_key = dvb_get_tp_key ( data );
+
+	int adapter  = (int)dvb_get_field ( data, "adapter",  0 );
+	int frontend = (int)dvb_get_field ( data, "frontend", 0 );
+	uint delsys  = (uint)dvb_get_field ( data, "delsys",  32 );
+
+	g_mutex_lock ( &dvb_pool_mutex );
+
+	if ( !dvb_pool ) dvb_pool_init ();
+
+	DvbTuner *tuner = NULL, *tuner_own = NULL, *tuner_any = NULL;
+
+	uint i = 0; for ( i = 0; i < dvb_pool->len; i++ )
+	{
+		DvbTuner *t = g_ptr_array_index ( dvb_pool, i );
+
+		if ( !dvb_pool_fit ( t, delsys ) ) continue;
+
+		/* Still locked to this transponder from the last use */
+		if ( t->tp_key && g_str_equal ( t->tp_key, tp_key ) ) { tuner = t; break; }
+
+		if ( t->adapter == adapter && t->frontend == frontend ) tuner_own = t;
+
+		if ( !tuner_any ) tuner_any = t;
+	}
+
+	if ( !tuner ) tuner = ( tuner_own ) ? tuner_own : tuner_any;
+
+	/* Nothing free: a foreground user takes a tuner from background work */
+	for ( i = 0; !tuner && !preempt && i < dvb_pool->len; i++ )
+	{
+		DvbTuner *t = g_ptr_array_index ( dvb_pool, i );
+
+		if ( t->preempt && dvb_pool_fit_delsys ( t, delsys ) ) tuner = t;
+	}
+
+	DvbPreempt stop = NULL;
+	gpointer stop_data = NULL;
+
+	if ( tuner )
+	{
+		stop = tuner->preempt;
+		stop_data = tuner->preempt_data;
+
+		tuner->users = 1;
+		tuner->preempt = preempt;
+		tuner->preempt_data = preempt_data;
+
+		free ( tuner->tp_key );
+		tuner->tp_key = g_strdup ( tp_key );
+
+		g_debug ( "%s:: %s: adapter %d, frontend %d %s ", __func__, tuner->name, tuner->adapter, tuner->frontend, ( preempt ) ? "( background )" : "" );
+	}
+
+	g_mutex_unlock ( &dvb_pool_mutex );
+
+	/* The background owner stops its pipeline and drops the tuner without a release */
+	if ( stop ) stop ( stop_data );
+
+	return tuner;
+}
+
+DvbTuner * dvb_pool_acquire ( const char *data )
+{
+	return dvb_pool_take ( data, NULL, NULL );
+}
+
+/* Only free tuners; preempt is called when a foreground user needs the tuner back */
+DvbTuner * dvb_pool_acquire_idle ( const char *data, DvbPreempt preempt, gpointer preempt_data )
+{
+	return dvb_pool_take ( data, preempt, preempt_data );
+}
+
+void dvb_pool_set_dvbsrc ( DvbTuner *tuner, GstElement *dvbsrc )
+{
+	g_object_set ( dvbsrc, "adapter", tuner->adapter, "frontend", tuner->frontend, NULL );
+}
+
+void dvb_pool_release ( DvbTuner *tuner )
+{
+	g_mutex_lock ( &dvb_pool_mutex );
+
+	tuner->users = 0;
+	tuner->preempt = NULL;
+	tuner->preempt_data = NULL;
+
+	g_mutex_unlock ( &dvb_pool_mutex );
+}
+
+static int dvb_pool_play_flags ( GstElement *pipeline, int set, int unset )
+{
+	g_mutex_lock ( &dvb_play_mutex );
+
+	int flags = GPOINTER_TO_INT ( g_object_get_data ( G_OBJECT ( pipeline ), "pool-play" ) );
+
+	g_object_set_data ( G_OBJECT ( pipeline ), "pool-play", GINT_TO_POINTER ( ( flags | set ) & ~unset ) );
+
+	if ( unset & DVB_PLAY_BUSY ) g_cond_broadcast ( &dvb_play_cond );
+
+	g_mutex_unlock ( &dvb_play_mutex );
+
+	return flags;
+}
+
+static void dvb_pool_play_async ( GstElement *pipeline, G_GNUC_UNUSED gpointer data )
+{
+	if ( dvb_pool_play_flags ( pipeline, DVB_PLAY_BUSY, 0 ) & DVB_PLAY_STOP ) { dvb_pool_play_flags ( pipeline, 0, DVB_PLAY_BUSY ); return; }
+
+	gst_element_set_state ( pipeline, GST_STATE_PLAYING );
+
+	dvb_pool_play_flags ( pipeline, 0, DVB_PLAY_BUSY );
+}
+
+/* dvbsrc tunes inside the state change: keep it off the main loop */
+void dvb_pool_play ( GstElement *pipeline )
+{
+	gst_element_call_async ( pipeline, (GstElementCallAsyncFunc)dvb_pool_play_async, NULL, NULL );
+}
+
+/* Waits for a tune in progress: the frontend is closed on return, so the tuner can be handed over */
+void dvb_pool_stop ( GstElement *pipeline )
+{
+	g_mutex_lock ( &dvb_play_mutex );
+
+	int flags = GPOINTER_TO_INT ( g_object_get_data ( G_OBJECT ( pipeline ), "pool-play" ) );
+
+	g_object_set_data ( G_OBJECT ( pipeline ), "pool-play", GINT_TO_POINTER ( flags | DVB_PLAY_STOP ) );
+
+	while ( GPOINTER_TO_INT ( g_object_get_data ( G_OBJECT ( pipeline ), "pool-play" ) ) & DVB_PLAY_BUSY ) g_cond_wait ( &dvb_play_cond, &dvb_play_mutex );
+
+	g_mutex_unlock ( &dvb_play_mutex );
+
+	gst_element_set_state ( pipeline, GST_STATE_NULL );
+}
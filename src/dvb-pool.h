@@ -0,0 +1,28 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+
+typedef struct _DvbTuner DvbTuner;
+
+typedef void ( *DvbPreempt ) ( gpointer );
+
+DvbTuner * dvb_pool_acquire ( const char * );
+
+DvbTuner * dvb_pool_acquire_idle ( const char *, DvbPreempt, gpointer );
+
+void dvb_pool_set_dvbsrc ( DvbTuner *, GstElement * );
+
+void dvb_pool_release ( DvbTuner * );
+
+void dvb_pool_play ( GstElement * );
+
+void dvb_pool_stop ( GstElement * );
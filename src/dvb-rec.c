@@ -0,0 +1,498 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "dvb-rec.h"
+#include "ts-rec.h"
+#include "include.h"
+
+#include <stdlib.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/mpegts/mpegts.h>
+
+static const char *dvb_rec_mode_id[REC_NUM] = { "remux", "pass", "mpts" };
+
+typedef struct _DvbRecStop DvbRecStop;
+
+struct _DvbRecStop
+{
+	GstElement *tee;
+	GstElement *recbin;
+	GstElement *recmux;
+	GstElement *recsink;
+
+	GstPad *pad_tee;
+
+	GDestroyNotify done;
+	gpointer data;
+
+	int eos;
+	uint8_t wait;
+};
+
+gboolean dvb_pad_check_type ( GstPad *pad, const char *type )
+{
+	gboolean ret = FALSE;
+
+	GstCaps *caps = gst_pad_get_current_caps ( pad );
+
+	if ( !caps ) return FALSE;
+	if ( !GST_IS_CAPS ( caps ) ) return FALSE;
+
+	const char *name = gst_structure_get_name ( gst_caps_get_structure ( caps, 0 ) );
+
+	if ( name && g_str_has_prefix ( name, type ) ) ret = TRUE;
+
+	gst_caps_unref (caps);
+
+	return ret;
+}
+
+void dvb_pad_link ( GstPad *pad, GstElement *element, const char *name )
+{
+	GstPad *pad_sink = gst_element_get_static_pad ( element, "sink" );
+
+	if ( gst_pad_link ( pad, pad_sink ) == GST_PAD_LINK_OK )
+		g_debug ( "%s:: linking Ok; %s", __func__, name );
+	else
+		g_debug ( "%s:: linking Failed; %s", __func__, name );
+
+	gst_object_unref ( pad_sink );
+}
+
+static void dvb_factory_unref ( gpointer factory )
+{
+	if ( factory ) gst_object_unref ( factory );
+}
+
+/* Parsers differ by media type, and for MPEG by version: resolution, rate or framerate never pick another one */
+static GstCaps * dvb_factory_caps ( GstCaps *caps )
+{
+	const GstStructure *structure = gst_caps_get_structure ( caps, 0 );
+
+	GstStructure *key = gst_structure_new_empty ( gst_structure_get_name ( structure ) );
+
+	int version = 0;
+	if ( gst_structure_get_int ( structure, "mpegversion", &version ) ) gst_structure_set ( key, "mpegversion", G_TYPE_INT, version, NULL );
+
+	return gst_caps_new_full ( key, NULL );
+}
+
+/* Parser for the caps; misses are cached too */
+static GstElementFactory * dvb_find_factory ( GstCaps *caps )
+{
+	static GMutex mutex;
+	static GList *list = NULL;
+	static GHashTable *cache = NULL;
+
+	if ( gst_caps_is_empty ( caps ) || gst_caps_is_any ( caps ) ) return NULL;
+
+	GstCaps *caps_key = dvb_factory_caps ( caps );
+
+	char *key = gst_caps_to_string ( caps_key );
+
+	g_mutex_lock ( &mutex );
+
+	if ( !cache )
+	{
+		cache = g_hash_table_new_full ( g_str_hash, g_str_equal, free, dvb_factory_unref );
+		list  = gst_element_factory_list_get_elements ( GST_ELEMENT_FACTORY_TYPE_PARSER, GST_RANK_MARGINAL );
+	}
+
+	gpointer value = NULL;
+	GstElementFactory *factory = NULL;
+
+	if ( g_hash_table_lookup_extended ( cache, key, NULL, &value ) )
+		factory = value;
+	else
+	{
+		GList *list_filter = gst_element_factory_list_filter ( list, caps_key, GST_PAD_SINK, FALSE );
+
+		if ( list_filter ) factory = GST_ELEMENT_FACTORY_CAST ( gst_object_ref ( list_filter->data ) );
+
+		g_hash_table_insert ( cache, key, factory );
+		key = NULL;
+
+		gst_plugin_feature_list_free ( list_filter );
+	}
+
+	g_mutex_unlock ( &mutex );
+
+	gst_caps_unref ( caps_key );
+	free ( key );
+
+	return factory;
+}
+
+static void dvb_typefind_parser ( GstElement *typefind, G_GNUC_UNUSED uint probability, GstCaps *caps, GstElement *recmux )
+{
+	GstElementFactory *factory = dvb_find_factory ( caps );
+
+	GstElement *recbin = GST_ELEMENT ( gst_element_get_parent ( recmux ) );
+
+	GstElement *element = ( factory ) ? gst_element_factory_create ( factory, NULL ) : NULL;
+
+	if ( element )
+	{
+		gst_bin_add ( GST_BIN ( recbin ), element );
+
+		gst_element_link_many ( typefind, element, recmux, NULL );
+
+		gst_element_sync_state_with_parent ( element );
+	}
+	else
+	{
+		g_autofree char *str = gst_caps_to_string ( caps );
+
+		g_warning ( "%s:: no parser for %s ", __func__, str );
+
+		gst_element_link ( typefind, recmux );
+	}
+
+	gst_object_unref ( recbin );
+}
+
+static void dvb_create_elements_audio_video_rec ( GstPad *pad, const char *name, GstElement *recmux )
+{
+	GstElement *queue2   = gst_element_factory_make ( "queue2",   NULL );
+	GstElement *typefind = gst_element_factory_make ( "typefind", NULL );
+
+	if ( !queue2 || !typefind ) { g_critical ( "%s:: recbin ... - not created.", __func__ ); return; }
+
+	GstElement *recbin = GST_ELEMENT ( gst_element_get_parent ( recmux ) );
+
+	gst_bin_add_many ( GST_BIN ( recbin ), queue2, typefind, NULL );
+
+	gst_element_link ( queue2, typefind );
+
+	dvb_pad_link ( pad, queue2, g_str_has_prefix ( name, "audio" ) ? "demux-rec - audio" : "demux-rec - video" );
+
+	g_signal_connect ( typefind, "have-type", G_CALLBACK ( dvb_typefind_parser ), recmux );
+
+	gst_element_sync_state_with_parent ( queue2   );
+	gst_element_sync_state_with_parent ( typefind );
+
+	gst_object_unref ( recbin );
+}
+
+static void dvb_add_pad_demux_rec ( G_GNUC_UNUSED GstElement *element, GstPad *pad, GstElement *recmux )
+{
+	if ( dvb_pad_check_type ( pad, "audio" ) ) dvb_create_elements_audio_video_rec ( pad, "audio", recmux );
+	if ( dvb_pad_check_type ( pad, "video" ) ) dvb_create_elements_audio_video_rec ( pad, "video", recmux );
+}
+
+static GstElement * dvb_create_rec_remux ( const char *path, uint16_t sid, GstElement **recmux_ret, GstElement **recsink_ret )
+{
+	GstElement *recbin   = gst_bin_new ( "rec-bin" );
+	GstElement *recmux   = gst_element_factory_make ( "mpegtsmux", NULL );
+	GstElement *recdemux = gst_element_factory_make ( "tsdemux",   NULL );
+	GstElement *filesink = gst_element_factory_make ( "filesink",  NULL );
+
+	if ( !recbin || !recmux || !recdemux || !filesink ) { g_critical ( "%s:: recbin ... - not created. ", __func__ ); return NULL; }
+
+	gst_bin_add_many ( GST_BIN ( recbin ), recdemux, recmux, filesink, NULL );
+
+	g_object_set ( recdemux, "program-number", sid, NULL );
+	g_object_set ( filesink, "location", path, NULL );
+
+	gst_element_link ( recmux, filesink );
+
+	GstPad *pad_host = gst_element_get_static_pad ( recdemux, "sink" );
+	gst_element_add_pad ( recbin, gst_ghost_pad_new ( "sink", pad_host ) );
+	gst_object_unref ( pad_host );
+
+	g_signal_connect ( recdemux, "pad-added", G_CALLBACK ( dvb_add_pad_demux_rec ), recmux );
+
+	*recmux_ret  = recmux;
+	*recsink_ret = filesink;
+
+	return recbin;
+}
+
+static void dvb_rec_handoff ( G_GNUC_UNUSED GstElement *fakesink, GstBuffer *buffer, G_GNUC_UNUSED GstPad *pad, TsRec *ts_rec )
+{
+	GstMapInfo map;
+
+	if ( !gst_buffer_map ( buffer, &map, GST_MAP_READ ) ) return;
+
+	ts_rec_push ( ts_rec, map.data, map.size );
+
+	gst_buffer_unmap ( buffer, &map );
+}
+
+static GstElement * dvb_create_rec_pass ( const char *path, uint16_t sid, GstElement **recsink_ret )
+{
+	TsRec *ts_rec = ts_rec_new ( path, sid );
+
+	if ( !ts_rec ) return NULL;
+
+	GstElement *recbin   = gst_bin_new ( "rec-bin" );
+	GstElement *queue    = gst_element_factory_make ( "queue",    NULL );
+	GstElement *fakesink = gst_element_factory_make ( "fakesink", NULL );
+
+	if ( !recbin || !queue || !fakesink ) { g_critical ( "%s:: recbin ... - not created. ", __func__ ); ts_rec_free ( ts_rec ); return NULL; }
+
+	gst_bin_add_many ( GST_BIN ( recbin ), queue, fakesink, NULL );
+	gst_element_link ( queue, fakesink );
+
+	g_object_set ( queue, "max-size-buffers", 0, "max-size-time", (guint64)0, "max-size-bytes", 64 * 1024 * 1024, NULL );
+	g_object_set ( fakesink, "signal-handoffs", TRUE, "sync", FALSE, "async", FALSE, NULL );
+
+	g_object_set_data_full ( G_OBJECT ( fakesink ), "ts-rec", ts_rec, (GDestroyNotify)ts_rec_free );
+	g_signal_connect ( fakesink, "handoff", G_CALLBACK ( dvb_rec_handoff ), ts_rec );
+
+	GstPad *pad_host = gst_element_get_static_pad ( queue, "sink" );
+	gst_element_add_pad ( recbin, gst_ghost_pad_new ( "sink", pad_host ) );
+	gst_object_unref ( pad_host );
+
+	*recsink_ret = fakesink;
+
+	return recbin;
+}
+
+void dvb_rec_index_section ( GstMessage *msg )
+{
+	GKeyFile *index = g_object_get_data ( G_OBJECT ( GST_MESSAGE_SRC ( msg ) ), "rec-index" );
+
+	if ( !index ) return;
+
+	GstMpegtsSection *section = gst_message_parse_mpegts_section ( msg );
+
+	if ( !section ) return;
+
+	gboolean update = FALSE;
+
+	if ( GST_MPEGTS_SECTION_TYPE ( section ) == GST_MPEGTS_SECTION_PAT )
+	{
+		GPtrArray *pat = gst_mpegts_section_get_pat ( section );
+
+		uint i = 0; for ( i = 0; pat && i < pat->len; i++ )
+		{
+			GstMpegtsPatProgram *prog = g_ptr_array_index ( pat, i );
+
+			if ( prog->program_number == 0 ) continue;
+
+			char group[20];
+			sprintf ( group, "%u", prog->program_number );
+
+			g_key_file_set_integer ( index, group, "pmt-pid", prog->network_or_program_map_PID );
+
+			update = TRUE;
+		}
+
+		if ( pat ) g_ptr_array_unref ( pat );
+	}
+
+	if ( GST_MPEGTS_SECTION_TYPE ( section ) == GST_MPEGTS_SECTION_SDT )
+	{
+		const GstMpegtsSDT *sdt = gst_mpegts_section_get_sdt ( section );
+
+		uint i = 0, c = 0; for ( i = 0; sdt && sdt->actual_ts && i < sdt->services->len; i++ )
+		{
+			GstMpegtsSDTService *service = g_ptr_array_index ( sdt->services, i );
+
+			char group[20];
+			sprintf ( group, "%u", service->service_id );
+
+			g_key_file_set_boolean ( index, group, "scrambled", service->free_CA_mode );
+
+			for ( c = 0; c < service->descriptors->len; c++ )
+			{
+				GstMpegtsDescriptor *desc = g_ptr_array_index ( service->descriptors, c );
+
+				char *service_name = NULL, *provider_name = NULL;
+				GstMpegtsDVBServiceType service_type;
+
+				if ( desc->tag != GST_MTS_DESC_DVB_SERVICE ) continue;
+
+				if ( gst_mpegts_descriptor_parse_dvb_service ( desc, &service_type, &service_name, &provider_name ) )
+				{
+					g_key_file_set_integer ( index, group, "service-type", service_type );
+					g_key_file_set_string  ( index, group, "name",     ( service_name  ) ? service_name  : "" );
+					g_key_file_set_string  ( index, group, "provider", ( provider_name ) ? provider_name : "" );
+
+					free ( service_name  );
+					free ( provider_name );
+				}
+			}
+
+			update = TRUE;
+		}
+	}
+
+	gst_mpegts_section_unref ( section );
+
+	if ( !update ) return;
+
+	GError *err = NULL;
+	const char *path = g_object_get_data ( G_OBJECT ( GST_MESSAGE_SRC ( msg ) ), "rec-index-path" );
+
+	if ( !g_key_file_save_to_file ( index, path, &err ) )
+	{
+		g_warning ( "%s:: %s ", __func__, err->message );
+		g_error_free ( err );
+	}
+}
+
+static GstElement * dvb_create_rec_mpts ( const char *path, const char *tp_key, GstElement **recsink_ret )
+{
+	TsRec *ts_rec = ts_rec_new ( path, 0 );
+
+	if ( !ts_rec ) return NULL;
+
+	GstElement *recbin   = gst_bin_new ( "rec-bin" );
+	GstElement *queue    = gst_element_factory_make ( "queue",    NULL );
+	GstElement *tsparse  = gst_element_factory_make ( "tsparse",  NULL );
+	GstElement *fakesink = gst_element_factory_make ( "fakesink", NULL );
+
+	if ( !recbin || !queue || !tsparse || !fakesink ) { g_critical ( "%s:: recbin ... - not created. ", __func__ ); ts_rec_free ( ts_rec ); return NULL; }
+
+	gst_mpegts_initialize ();
+
+	gst_bin_add_many ( GST_BIN ( recbin ), queue, tsparse, fakesink, NULL );
+	gst_element_link_many ( queue, tsparse, fakesink, NULL );
+
+	g_object_set ( queue, "max-size-buffers", 0, "max-size-time", (guint64)0, "max-size-bytes", 64 * 1024 * 1024, NULL );
+	g_object_set ( fakesink, "signal-handoffs", TRUE, "sync", FALSE, "async", FALSE, NULL );
+
+	g_object_set_data_full ( G_OBJECT ( fakesink ), "ts-rec", ts_rec, (GDestroyNotify)ts_rec_free );
+	g_signal_connect ( fakesink, "handoff", G_CALLBACK ( dvb_rec_handoff ), ts_rec );
+
+	GKeyFile *index = g_key_file_new ();
+	g_key_file_set_string ( index, "Transponder", "data", ( tp_key ) ? tp_key : "" );
+
+	g_object_set_data_full ( G_OBJECT ( tsparse ), "rec-index", index, (GDestroyNotify)g_key_file_unref );
+	g_object_set_data_full ( G_OBJECT ( tsparse ), "rec-index-path", g_strdup_printf ( "%s.idx", path ), free );
+
+	GstPad *pad_host = gst_element_get_static_pad ( queue, "sink" );
+	gst_element_add_pad ( recbin, gst_ghost_pad_new ( "sink", pad_host ) );
+	gst_object_unref ( pad_host );
+
+	*recsink_ret = fakesink;
+
+	return recbin;
+}
+
+uint8_t dvb_rec_get_mode ( const char *name )
+{
+	uint8_t c = 0; for ( c = 0; c < REC_NUM; c++ ) if ( g_str_equal ( name, dvb_rec_mode_id[c] ) ) return c;
+
+	return REC_NUM;
+}
+
+GstElement * dvb_rec_create_bin ( const char *path, uint8_t mode, uint16_t sid, const char *tp_key, GstElement **recmux_ret, GstElement **recsink_ret )
+{
+	*recmux_ret  = NULL;
+	*recsink_ret = NULL;
+
+	if ( mode == REC_REMUX ) return dvb_create_rec_remux ( path, sid, recmux_ret, recsink_ret );
+	if ( mode == REC_PASS  ) return dvb_create_rec_pass  ( path, sid, recsink_ret );
+	if ( mode == REC_MPTS  ) return dvb_create_rec_mpts  ( path, tp_key, recsink_ret );
+
+	return NULL;
+}
+
+GstPad * dvb_rec_attach ( GstElement *tee, GstElement *recbin )
+{
+	GstElement *parent = GST_ELEMENT ( gst_element_get_parent ( tee ) );
+
+	gst_bin_add ( GST_BIN ( parent ), recbin );
+	gst_element_sync_state_with_parent ( recbin );
+
+	GstPad *pad_tee = NULL;
+
+	if ( gst_element_link ( tee, recbin ) )
+	{
+		GstPad *pad_sink = gst_element_get_static_pad ( recbin, "sink" );
+		pad_tee = gst_pad_get_peer ( pad_sink );
+		gst_object_unref ( pad_sink );
+	}
+	else
+	{
+		g_critical ( "%s:: tee - recbin not linked. ", __func__ );
+
+		gst_element_set_state ( recbin, GST_STATE_NULL );
+		gst_bin_remove ( GST_BIN ( parent ), recbin );
+	}
+
+	gst_object_unref ( parent );
+
+	return pad_tee;
+}
+
+static gboolean dvb_rec_stop_wait ( DvbRecStop *rs )
+{
+	if ( !g_atomic_int_get ( &rs->eos ) && rs->wait++ < 50 ) return TRUE;
+
+	if ( !rs->eos ) g_warning ( "%s:: EOS timeout, the record may be truncated. ", __func__ );
+
+	gst_element_set_state ( rs->recbin, GST_STATE_NULL );
+
+	GstObject *parent = gst_object_get_parent ( GST_OBJECT ( rs->recbin ) );
+
+	if ( parent ) { gst_bin_remove ( GST_BIN ( parent ), rs->recbin ); gst_object_unref ( parent ); }
+
+	gst_element_release_request_pad ( rs->tee, rs->pad_tee );
+
+	gst_object_unref ( rs->pad_tee );
+	gst_object_unref ( rs->recbin );
+	gst_object_unref ( rs->tee );
+
+	if ( rs->done ) rs->done ( rs->data );
+
+	free ( rs );
+
+	return FALSE;
+}
+
+static GstPadProbeReturn dvb_rec_eos_probe ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, DvbRecStop *rs )
+{
+	if ( GST_EVENT_TYPE ( GST_PAD_PROBE_INFO_EVENT ( info ) ) != GST_EVENT_EOS ) return GST_PAD_PROBE_OK;
+
+	g_atomic_int_set ( &rs->eos, TRUE );
+
+	return GST_PAD_PROBE_DROP;
+}
+
+static GstPadProbeReturn dvb_rec_unlink_probe ( GstPad *pad, G_GNUC_UNUSED GstPadProbeInfo *info, DvbRecStop *rs )
+{
+	GstPad *pad_sink = gst_element_get_static_pad ( rs->recbin, "sink" );
+
+	gst_pad_unlink ( pad, pad_sink );
+
+	if ( rs->recmux && GST_ELEMENT_CAST ( rs->recmux )->numsinkpads == 0 )
+		g_atomic_int_set ( &rs->eos, TRUE );
+	else
+		gst_pad_send_event ( pad_sink, gst_event_new_eos () );
+
+	gst_object_unref ( pad_sink );
+
+	return GST_PAD_PROBE_REMOVE;
+}
+
+void dvb_rec_detach ( GstElement *tee, GstElement *recbin, GstElement *recmux, GstElement *recsink, GstPad *pad_tee, GDestroyNotify done, gpointer data )
+{
+	DvbRecStop *rs = g_new0 ( DvbRecStop, 1 );
+
+	rs->tee     = gst_object_ref ( tee );
+	rs->recbin  = gst_object_ref ( recbin );
+	rs->recmux  = recmux;
+	rs->recsink = recsink;
+	rs->pad_tee = pad_tee;
+	rs->done    = done;
+	rs->data    = data;
+
+	GstPad *pad_sink = gst_element_get_static_pad ( rs->recsink, "sink" );
+	gst_pad_add_probe ( pad_sink, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback)dvb_rec_eos_probe, rs, NULL );
+	gst_object_unref ( pad_sink );
+
+	gst_pad_add_probe ( rs->pad_tee, GST_PAD_PROBE_TYPE_IDLE, (GstPadProbeCallback)dvb_rec_unlink_probe, rs, NULL );
+
+	g_timeout_add ( 100, (GSourceFunc)dvb_rec_stop_wait, rs );
+}
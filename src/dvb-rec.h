@@ -0,0 +1,26 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+
+gboolean dvb_pad_check_type ( GstPad *, const char * );
+
+void dvb_pad_link ( GstPad *, GstElement *, const char * );
+
+uint8_t dvb_rec_get_mode ( const char * );
+
+GstElement * dvb_rec_create_bin ( const char *, uint8_t, uint16_t, const char *, GstElement **, GstElement ** );
+
+GstPad * dvb_rec_attach ( GstElement *, GstElement * );
+
+void dvb_rec_detach ( GstElement *, GstElement *, GstElement *, GstElement *, GstPad *, GDestroyNotify, gpointer );
+
+void dvb_rec_index_section ( GstMessage * );
@@ -0,0 +1,337 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "dvb-stats.h"
+
+#include <stdlib.h>
+
+#define DVB_STATS_TICK 1
+#define DVB_STATS_LOG  5
+
+typedef struct _DvbStage DvbStage;
+
+struct _DvbStage
+{
+	char *name;
+	DvbStats *stats;
+	GstElement *queue;
+
+	guint64 bytes;
+	guint64 buffers;
+	guint64 lat_n;
+
+	gint64 lat_sum;
+	gint64 lat_max;
+};
+
+struct _DvbStats
+{
+	GMutex mutex;
+	GPtrArray *stages;
+	GHashTable *qos;
+	GstElement *overlay;
+
+	guint64 late;
+	gint64 t_last;
+
+	uint src_tm;
+	uint n_tick;
+};
+
+static void dvb_stage_free ( DvbStage *stage )
+{
+	if ( stage->queue ) gst_object_unref ( stage->queue );
+
+	free ( stage->name );
+	free ( stage );
+}
+
+/* Also reached from the tsdemux pad-added streaming thread */
+static DvbStage * dvb_stats_stage ( DvbStats *stats, const char *name )
+{
+	g_mutex_lock ( &stats->mutex );
+
+	DvbStage *stage = NULL;
+
+	uint j = 0; for ( j = 0; j < stats->stages->len; j++ )
+	{
+		stage = g_ptr_array_index ( stats->stages, j );
+
+		if ( g_str_equal ( stage->name, name ) ) break;
+
+		stage = NULL;
+	}
+
+	if ( !stage )
+	{
+		stage = g_new0 ( DvbStage, 1 );
+
+		stage->name  = g_strdup ( name );
+		stage->stats = stats;
+
+		g_ptr_array_add ( stats->stages, stage );
+	}
+
+	g_mutex_unlock ( &stats->mutex );
+
+	return stage;
+}
+
+static gboolean dvb_stats_running_time ( GstPad *pad, GstBuffer *buffer, gint64 *lat )
+{
+	if ( !GST_BUFFER_PTS_IS_VALID ( buffer ) ) return FALSE;
+
+	GstElement *element = gst_pad_get_parent_element ( pad );
+
+	if ( !element ) return FALSE;
+
+	GstClock *clock = gst_element_get_clock ( element );
+	GstClockTime base_time = gst_element_get_base_time ( element );
+
+	gst_object_unref ( element );
+
+	if ( !clock ) return FALSE;
+
+	GstClockTime now = gst_clock_get_time ( clock );
+
+	gst_object_unref ( clock );
+
+	GstEvent *event = gst_pad_get_sticky_event ( pad, GST_EVENT_SEGMENT, 0 );
+
+	if ( !event ) return FALSE;
+
+	const GstSegment *segment = NULL;
+	gst_event_parse_segment ( event, &segment );
+
+	guint64 running = gst_segment_to_running_time ( segment, GST_FORMAT_TIME, GST_BUFFER_PTS ( buffer ) );
+
+	gst_event_unref ( event );
+
+	if ( running == GST_CLOCK_TIME_NONE || now < base_time ) return FALSE;
+
+	*lat = (gint64)( now - base_time ) - (gint64)running;
+
+	return TRUE;
+}
+
+static GstPadProbeReturn dvb_stats_probe_buffer ( GstPad *pad, GstPadProbeInfo *info, DvbStage *stage )
+{
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER ( info );
+
+	gint64 lat = 0;
+	gboolean ret = dvb_stats_running_time ( pad, buffer, &lat );
+
+	g_mutex_lock ( &stage->stats->mutex );
+
+	stage->bytes += gst_buffer_get_size ( buffer );
+	stage->buffers++;
+
+	if ( ret )
+	{
+		stage->lat_n++;
+		stage->lat_sum += lat;
+
+		if ( stage->lat_n == 1 || lat > stage->lat_max ) stage->lat_max = lat;
+	}
+
+	g_mutex_unlock ( &stage->stats->mutex );
+
+	return GST_PAD_PROBE_OK;
+}
+
+void dvb_stats_probe ( DvbStats *stats, const char *name, GstPad *pad )
+{
+	DvbStage *stage = dvb_stats_stage ( stats, name );
+
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)dvb_stats_probe_buffer, stage, NULL );
+}
+
+static void dvb_stats_pad_added ( G_GNUC_UNUSED GstElement *element, GstPad *pad, DvbStage *stage )
+{
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)dvb_stats_probe_buffer, stage, NULL );
+}
+
+void dvb_stats_probe_added ( DvbStats *stats, const char *name, GstElement *element )
+{
+	DvbStage *stage = dvb_stats_stage ( stats, name );
+
+	g_signal_connect ( element, "pad-added", G_CALLBACK ( dvb_stats_pad_added ), stage );
+}
+
+void dvb_stats_queue ( DvbStats *stats, const char *name, GstElement *queue )
+{
+	DvbStage *stage = dvb_stats_stage ( stats, name );
+
+	if ( stage->queue ) gst_object_unref ( stage->queue );
+
+	stage->queue = gst_object_ref ( queue );
+
+	GstPad *pad = gst_element_get_static_pad ( queue, "src" );
+
+	dvb_stats_probe ( stats, name, pad );
+
+	gst_object_unref ( pad );
+}
+
+void dvb_stats_overlay ( DvbStats *stats, GstElement *overlay )
+{
+	if ( stats->overlay ) gst_object_unref ( stats->overlay );
+
+	stats->overlay = gst_object_ref ( overlay );
+
+	g_object_set ( overlay, "valignment", 2, "halignment", 0, "shaded-background", TRUE, "font-desc", "Monospace 10", NULL );
+}
+
+void dvb_stats_message ( DvbStats *stats, GstMessage *msg )
+{
+	if ( GST_MESSAGE_TYPE ( msg ) != GST_MESSAGE_QOS ) return;
+
+	GstFormat format;
+	guint64 processed = 0, dropped = 0;
+	gint64 jitter = 0;
+
+	gst_message_parse_qos_stats  ( msg, &format, &processed, &dropped );
+	gst_message_parse_qos_values ( msg, &jitter, NULL, NULL );
+
+	if ( format == GST_FORMAT_BUFFERS || format == GST_FORMAT_DEFAULT )
+		g_hash_table_insert ( stats->qos, g_strdup ( GST_OBJECT_NAME ( GST_MESSAGE_SRC ( msg ) ) ), GUINT_TO_POINTER ( (uint)dropped ) );
+
+	if ( jitter > 0 ) stats->late++;
+}
+
+static guint64 dvb_stats_dropped ( DvbStats *stats )
+{
+	guint64 dropped = 0;
+
+	GHashTableIter iter;
+	gpointer value = NULL;
+
+	g_hash_table_iter_init ( &iter, stats->qos );
+
+	while ( g_hash_table_iter_next ( &iter, NULL, &value ) ) dropped += GPOINTER_TO_UINT ( value );
+
+	return dropped;
+}
+
+static gboolean dvb_stats_tick ( DvbStats *stats )
+{
+	gint64 t_now = g_get_monotonic_time ();
+	double sec = (double)( t_now - stats->t_last ) / G_USEC_PER_SEC;
+
+	stats->t_last = t_now;
+
+	if ( sec <= 0 ) return G_SOURCE_CONTINUE;
+
+	GString *text = g_string_new ( NULL );
+	GString *json = g_string_new ( "{\"stages\":[" );
+
+	g_mutex_lock ( &stats->mutex );
+
+	uint j = 0; for ( j = 0; j < stats->stages->len; j++ )
+	{
+		DvbStage *stage = g_ptr_array_index ( stats->stages, j );
+
+		double kbps = (double)stage->bytes * 8 / 1000 / sec;
+		double lat_avg = ( stage->lat_n ) ? (double)stage->lat_sum / (double)stage->lat_n / GST_MSECOND : 0;
+		double lat_max = ( stage->lat_n ) ? (double)stage->lat_max / GST_MSECOND : 0;
+
+		g_string_append_printf ( text, "%-13s %8.1f kbit/s  %7.1f / %7.1f ms", stage->name, kbps, lat_avg, lat_max );
+		g_string_append_printf ( json, "%s{\"name\":\"%s\",\"kbps\":%.1f,\"buffers\":%" G_GUINT64_FORMAT ",\"lat_avg_ms\":%.1f,\"lat_max_ms\":%.1f",
+			( j ) ? "," : "", stage->name, kbps, stage->buffers, lat_avg, lat_max );
+
+		if ( stage->queue )
+		{
+			uint level_bytes = 0, max_bytes = 0;
+			guint64 level_time = 0;
+
+			g_object_get ( stage->queue, "current-level-bytes", &level_bytes, "current-level-time", &level_time, "max-size-bytes", &max_bytes, NULL );
+
+			uint fill = ( max_bytes ) ? (uint)( (guint64)level_bytes * 100 / max_bytes ) : 0;
+
+			g_string_append_printf ( text, "  fill %u KB %" G_GUINT64_FORMAT " ms %u%%", level_bytes / 1000, level_time / GST_MSECOND, fill );
+			g_string_append_printf ( json, ",\"fill_bytes\":%u,\"fill_ms\":%" G_GUINT64_FORMAT ",\"fill_pct\":%u", level_bytes, level_time / GST_MSECOND, fill );
+		}
+
+		g_string_append_c ( text, '\n' );
+		g_string_append_c ( json, '}' );
+
+		stage->bytes = stage->buffers = stage->lat_n = 0;
+		stage->lat_sum = stage->lat_max = 0;
+	}
+
+	g_mutex_unlock ( &stats->mutex );
+
+	guint64 dropped = dvb_stats_dropped ( stats );
+
+	g_string_append_printf ( text, "dropped %" G_GUINT64_FORMAT "  late %" G_GUINT64_FORMAT, dropped, stats->late );
+	g_string_append_printf ( json, "],\"dropped\":%" G_GUINT64_FORMAT ",\"late\":%" G_GUINT64_FORMAT "}", dropped, stats->late );
+
+	if ( stats->overlay ) g_object_set ( stats->overlay, "text", text->str, NULL );
+
+	if ( ++stats->n_tick % DVB_STATS_LOG == 0 )
+		g_log_structured ( G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE, "HELIA_STATS", json->str, "MESSAGE", "%s:: %s", __func__, json->str );
+
+	g_string_free ( json, TRUE );
+	g_string_free ( text, TRUE );
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* Counters only: the decoder bins with their queues and overlay outlive a retune */
+void dvb_stats_reset ( DvbStats *stats )
+{
+	g_mutex_lock ( &stats->mutex );
+
+	uint j = 0; for ( j = 0; j < stats->stages->len; j++ )
+	{
+		DvbStage *stage = g_ptr_array_index ( stats->stages, j );
+
+		stage->bytes = stage->buffers = stage->lat_n = 0;
+		stage->lat_sum = stage->lat_max = 0;
+	}
+
+	g_mutex_unlock ( &stats->mutex );
+
+	stats->late = 0;
+
+	g_hash_table_remove_all ( stats->qos );
+}
+
+DvbStats * dvb_stats_new ( void )
+{
+	const char *env = g_getenv ( "HELIA_STATS" );
+
+	if ( !env || !env[0] || g_str_equal ( env, "0" ) ) return NULL;
+
+	DvbStats *stats = g_new0 ( DvbStats, 1 );
+
+	g_mutex_init ( &stats->mutex );
+
+	stats->stages = g_ptr_array_new_with_free_func ( (GDestroyNotify)dvb_stage_free );
+	stats->qos = g_hash_table_new_full ( g_str_hash, g_str_equal, free, NULL );
+
+	stats->t_last = g_get_monotonic_time ();
+	stats->src_tm = g_timeout_add_seconds ( DVB_STATS_TICK, (GSourceFunc)dvb_stats_tick, stats );
+
+	return stats;
+}
+
+void dvb_stats_free ( DvbStats *stats )
+{
+	if ( stats->src_tm ) g_source_remove ( stats->src_tm );
+
+	if ( stats->overlay ) gst_object_unref ( stats->overlay );
+
+	g_ptr_array_free ( stats->stages, TRUE );
+	g_hash_table_destroy ( stats->qos );
+
+	g_mutex_clear ( &stats->mutex );
+
+	free ( stats );
+}
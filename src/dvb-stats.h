@@ -0,0 +1,30 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+
+typedef struct _DvbStats DvbStats;
+
+DvbStats * dvb_stats_new ( void );
+
+void dvb_stats_probe ( DvbStats *, const char *, GstPad * );
+
+void dvb_stats_probe_added ( DvbStats *, const char *, GstElement * );
+
+void dvb_stats_queue ( DvbStats *, const char *, GstElement * );
+
+void dvb_stats_overlay ( DvbStats *, GstElement * );
+
+void dvb_stats_message ( DvbStats *, GstMessage * );
+
+void dvb_stats_reset ( DvbStats * );
+
+void dvb_stats_free ( DvbStats * );
@@ -0,0 +1,304 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "dvb-tune.h"
+#include "descr.h"
+#include "include.h"
+#include "dvb-linux.h"
+
+#include <stdlib.h>
+
+static void dvb_set_tuning_timeout ( GstElement *element )
+{
+	guint64 timeout = 0;
+	g_object_get ( element, "tuning-timeout", &timeout, NULL );
+	g_object_set ( element, "tuning-timeout", (guint64)timeout / 4, NULL );
+}
+
+static void dvb_rinit ( GstElement *element )
+{
+	int adapter = 0, frontend = 0;
+	g_object_get ( element, "adapter",  &adapter,  NULL );
+	g_object_get ( element, "frontend", &frontend, NULL );
+
+	g_autofree char *dvb_name = dvb_get_name ( adapter, frontend );
+
+	g_debug ( "%s:: %s ", __func__, dvb_name );
+}
+
+enum DvbChanKind
+{
+	CHAN_GST,
+	CHAN_SKIP,
+	CHAN_SID,
+	CHAN_POL,
+	CHAN_SRATE,
+	CHAN_LNB
+};
+
+/* Records no model references are dropped once the cache doubles since the last sweep */
+#define DVB_CHAN_CACHE_MIN 4096
+
+static GHashTable *dvb_chan_cache = NULL;
+static GMutex dvb_chan_mutex;
+
+static uint dvb_chan_limit = DVB_CHAN_CACHE_MIN;
+static uint dvb_chan_sweep_id = 0;
+
+static uint8_t dvb_chan_kind ( const char *key )
+{
+	if ( g_str_equal ( key, "audio-pid" ) || g_str_equal ( key, "video-pid" ) ) return CHAN_SKIP;
+	if ( g_str_equal ( key, "service-type" ) || g_str_equal ( key, "scrambled" ) ) return CHAN_SKIP;
+
+	if ( g_str_equal ( key, "program-number" ) ) return CHAN_SID;
+	if ( g_str_equal ( key, "polarity"    ) ) return CHAN_POL;
+	if ( g_str_equal ( key, "symbol-rate" ) ) return CHAN_SRATE;
+	if ( g_str_equal ( key, "lnb-type"    ) ) return CHAN_LNB;
+
+	return CHAN_GST;
+}
+
+static DvbChan * dvb_chan_parse ( const char *data )
+{
+	DvbChan *chan = g_new0 ( DvbChan, 1 );
+
+	chan->data = g_strdup ( data );
+
+	char **fields = g_strsplit ( data, ":", 0 );
+	uint j = 0, numfields = g_strv_length ( fields );
+
+	chan->name  = g_strdup ( ( numfields ) ? fields[0] : "" );
+	chan->props = g_new0 ( DvbChanProp, numfields );
+
+	GString *gstring = g_string_new ( NULL );
+
+	for ( j = 1; j < numfields; j++ )
+	{
+		char *eq = strchr ( fields[j], '=' );
+
+		if ( !eq ) continue;
+
+		DvbChanProp *prop = &chan->props[chan->n_props++];
+
+		prop->key   = g_strndup ( fields[j], (gsize)( eq - fields[j] ) );
+		prop->value = g_strdup ( eq + 1 );
+		prop->num   = atol ( prop->value );
+		prop->kind  = dvb_chan_kind ( prop->key );
+
+		if ( prop->kind == CHAN_SID ) chan->sid = (uint16_t)prop->num;
+		if ( prop->kind == CHAN_LNB ) chan->lnb = (uint8_t)prop->num;
+
+		if ( g_str_has_prefix ( prop->key, "lnb-lof" ) ) chan->lo_found = TRUE;
+
+		if ( prop->kind == CHAN_SID || prop->kind == CHAN_SKIP || g_str_equal ( prop->key, "adapter" ) || g_str_equal ( prop->key, "frontend" ) ) continue;
+
+		g_string_append_printf ( gstring, ":%s", fields[j] );
+	}
+
+	chan->tp_key = g_string_free ( gstring, FALSE );
+
+	g_strfreev ( fields );
+
+	return chan;
+}
+
+static void dvb_chan_free ( DvbChan *chan )
+{
+	uint j = 0; for ( j = 0; j < chan->n_props; j++ )
+	{
+		free ( chan->props[j].key );
+		free ( chan->props[j].value );
+	}
+
+	free ( chan->props );
+	free ( chan->tp_key );
+	free ( chan->name );
+	free ( chan->data );
+	free ( chan );
+}
+
+static gboolean dvb_chan_unused ( G_GNUC_UNUSED gpointer key, DvbChan *chan, G_GNUC_UNUSED gpointer data )
+{
+	return ( g_atomic_int_get ( &chan->refs ) == 0 );
+}
+
+static gboolean dvb_chan_sweep ( G_GNUC_UNUSED gpointer data )
+{
+	g_mutex_lock ( &dvb_chan_mutex );
+
+	uint removed = g_hash_table_foreach_remove ( dvb_chan_cache, (GHRFunc)dvb_chan_unused, NULL );
+	uint size = g_hash_table_size ( dvb_chan_cache );
+
+	dvb_chan_limit = MAX ( DVB_CHAN_CACHE_MIN, size * 2 );
+	dvb_chan_sweep_id = 0;
+
+	g_mutex_unlock ( &dvb_chan_mutex );
+
+	g_debug ( "%s:: removed %u, kept %u ", __func__, removed, size );
+
+	return G_SOURCE_REMOVE;
+}
+
+DvbChan * dvb_chan_get ( const char *data )
+{
+	g_mutex_lock ( &dvb_chan_mutex );
+
+	if ( !dvb_chan_cache ) dvb_chan_cache = g_hash_table_new_full ( g_str_hash, g_str_equal, NULL, (GDestroyNotify)dvb_chan_free );
+
+	DvbChan *chan = g_hash_table_lookup ( dvb_chan_cache, data );
+
+	if ( !chan )
+	{
+		chan = dvb_chan_parse ( data );
+
+		g_hash_table_insert ( dvb_chan_cache, chan->data, chan );
+
+		/* On the main loop, so no borrowed record is freed under a caller */
+		if ( g_hash_table_size ( dvb_chan_cache ) > dvb_chan_limit && !dvb_chan_sweep_id )
+			dvb_chan_sweep_id = g_idle_add ( dvb_chan_sweep, NULL );
+	}
+
+	g_mutex_unlock ( &dvb_chan_mutex );
+
+	return chan;
+}
+
+void dvb_chan_ref ( const DvbChan *chan )
+{
+	g_atomic_int_inc ( &( (DvbChan *)chan )->refs );
+}
+
+void dvb_chan_unref ( const DvbChan *chan )
+{
+	g_atomic_int_add ( &( (DvbChan *)chan )->refs, -1 );
+}
+
+const DvbChanProp * dvb_chan_find ( const DvbChan *chan, const char *key )
+{
+	uint j = 0; for ( j = 0; j < chan->n_props; j++ )
+		if ( g_str_equal ( chan->props[j].key, key ) ) return &chan->props[j];
+
+	return NULL;
+}
+
+static void dvb_chan_set_prop ( GstElement *element, DvbChanProp *prop, long dat )
+{
+	g_mutex_lock ( &dvb_chan_mutex );
+
+	if ( !prop->pspec ) prop->pspec = g_object_class_find_property ( G_OBJECT_GET_CLASS ( element ), prop->key );
+
+	GParamSpec *pspec = prop->pspec;
+
+	g_mutex_unlock ( &dvb_chan_mutex );
+
+	if ( !pspec ) { g_warning ( "%s:: %s - unknown property. ", __func__, prop->key ); return; }
+
+	GValue value = G_VALUE_INIT;
+	g_value_init ( &value, pspec->value_type );
+
+	switch ( G_TYPE_FUNDAMENTAL ( pspec->value_type ) )
+	{
+		case G_TYPE_ENUM:    g_value_set_enum    ( &value, (int)dat );     break;
+		case G_TYPE_INT:     g_value_set_int     ( &value, (int)dat );     break;
+		case G_TYPE_UINT:    g_value_set_uint    ( &value, (uint)dat );    break;
+		case G_TYPE_LONG:    g_value_set_long    ( &value, dat );          break;
+		case G_TYPE_ULONG:   g_value_set_ulong   ( &value, (gulong)dat );  break;
+		case G_TYPE_INT64:   g_value_set_int64   ( &value, dat );          break;
+		case G_TYPE_UINT64:  g_value_set_uint64  ( &value, (guint64)dat ); break;
+		case G_TYPE_BOOLEAN: g_value_set_boolean ( &value, dat != 0 );     break;
+		case G_TYPE_STRING:  g_value_set_string  ( &value, prop->value );  break;
+
+		default: g_warning ( "%s:: %s - unsupported type. ", __func__, prop->key ); g_value_unset ( &value ); return;
+	}
+
+	g_object_set_property ( G_OBJECT ( element ), pspec->name, &value );
+
+	g_value_unset ( &value );
+}
+
+RetSidLnb dvb_data_set ( const char *data, GstElement *element, GstElement *demux )
+{
+	DvbChan *chan = dvb_chan_get ( data );
+
+	RetSidLnb sl;
+
+	sl.lnb = 0;
+	sl.sid = 0;
+	sl.lo_found = FALSE;
+
+	dvb_set_tuning_timeout ( element );
+
+	uint j = 0; for ( j = 0; j < chan->n_props; j++ )
+	{
+		DvbChanProp *prop = &chan->props[j];
+
+		g_debug ( "%s: gst-param %s | gst-value %s ", __func__, prop->key, prop->value );
+
+		switch ( prop->kind )
+		{
+			case CHAN_SKIP:
+				break;
+
+			case CHAN_POL:
+				if ( prop->value[0] == 'v' || prop->value[0] == 'V' || prop->value[0] == '0' )
+					g_object_set ( element, "polarity", "V", NULL );
+				else
+					g_object_set ( element, "polarity", "H", NULL );
+				break;
+
+			case CHAN_SID:
+				sl.sid = (uint16_t)prop->num;
+				if ( demux ) g_object_set ( demux, "program-number", (int)prop->num, NULL );
+				break;
+
+			case CHAN_SRATE:
+				dvb_chan_set_prop ( element, prop, ( prop->num > 1000000 ) ? prop->num / 1000 : prop->num );
+				break;
+
+			case CHAN_LNB:
+			{
+				sl.lnb = (uint8_t)prop->num;
+				sl.lo_found = chan->lo_found;
+
+				Descr *descr = descr_new ();
+
+				g_signal_emit_by_name ( descr, "descr-lnbs", (uint)prop->num, element );
+
+				g_object_unref ( descr );
+
+				break;
+			}
+
+			default:
+				dvb_chan_set_prop ( element, prop, prop->num );
+				break;
+		}
+	}
+
+	dvb_rinit ( element );
+
+	return sl;
+}
+
+long dvb_get_field ( const char *data, const char *name, long def )
+{
+	const DvbChanProp *prop = dvb_chan_find ( dvb_chan_get ( data ), name );
+
+	return ( prop ) ? prop->num : def;
+}
+
+uint16_t dvb_get_sid ( const char *data )
+{
+	return dvb_chan_get ( data )->sid;
+}
+
+char * dvb_get_tp_key ( const char *data )
+{
+	return g_strdup ( dvb_chan_get ( data )->tp_key );
+}
@@ -0,0 +1,70 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+
+typedef struct _RetSidLnb RetSidLnb;
+
+struct _RetSidLnb
+{
+	uint8_t lnb;
+	uint16_t sid;
+
+	gboolean lo_found;
+};
+
+typedef struct _DvbChanProp DvbChanProp;
+
+struct _DvbChanProp
+{
+	char *key;
+	char *value;
+
+	long num;
+	uint8_t kind;
+
+	GParamSpec *pspec;
+};
+
+typedef struct _DvbChan DvbChan;
+
+struct _DvbChan
+{
+	char *data;
+	char *name;
+	char *tp_key;
+
+	uint16_t sid;
+	uint8_t lnb;
+	gboolean lo_found;
+
+	uint n_props;
+	DvbChanProp *props;
+
+	int refs;
+};
+
+/* Borrowed: valid until the next main loop iteration unless a reference is taken */
+DvbChan * dvb_chan_get ( const char * );
+
+void dvb_chan_ref ( const DvbChan * );
+
+void dvb_chan_unref ( const DvbChan * );
+
+const DvbChanProp * dvb_chan_find ( const DvbChan *, const char * );
+
+RetSidLnb dvb_data_set ( const char *, GstElement *, GstElement * );
+
+long dvb_get_field ( const char *, const char *, long );
+
+uint16_t dvb_get_sid ( const char * );
+
+char * dvb_get_tp_key ( const char * );
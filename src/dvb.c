@@ -8,9 +8,15 @@
 */
 
 #include "dvb.h"
-#include "descr.h"
+#include "epg.h"
+#include "ts-rec.h"
+#include "tshift.h"
+#include "ts-file.h"
+#include "dvb-stats.h"
 #include "include.h"
-#include "dvb-linux.h"
+#include "dvb-rec.h"
+#include "dvb-pool.h"
+#include "dvb-tune.h"
 
 #include <time.h>
 #include <stdlib.h>
@@ -34,44 +40,59 @@ struct _Dvb
 	GstElement *dvbsrc;
 	GstElement *volume;
 	GstElement *queue_audio;
+	GstElement *dec_audio;
+	GstElement *dec_video;
 
 	GstElement *teerec;
+	GstElement *recbin;
 	GstElement *recmux;
-	GstElement *recdemux;
+	GstElement *recsink;
+
+	GstPad *pad_rec;
+
+	GstElement *tshift_sel;
+	GstElement *tshift_src;
+
+	TShift *tshift;
+
+	DvbTuner *tuner;
+
+	DvbStats *stats;
 
 	GstElement *tee_base;
+	GstElement *mosaic;
+
+	GstPad *pad_multi;
 
 	Level *level;
 
 	uint16_t sid;
 	uint8_t win_count;
+	uint8_t rec_mode;
 
 	guintptr xid;
 	uint src_tm;
+	uint tshift_tm;
+
+	gint64 tshift_time;
 
 	double volume_val;
 
 	char *rec_dir;
+	char *tp_key;
 
 	time_t t_hide;
 
 	gboolean record;
 	gboolean set_video;
 	gboolean first_audio;
-};
-
-typedef struct _RetSidLnb RetSidLnb;
-
-struct _RetSidLnb
-{
-	uint8_t lnb;
-	uint16_t sid;
-
-	gboolean lo_found;
+	gboolean tshift_pause;
 };
 
 G_DEFINE_TYPE ( Dvb, dvb, GTK_TYPE_DRAWING_AREA )
 
+const char *dvb_rec_mode_n[REC_NUM] = { "Remux", "Passthrough", "Transponder" };
+
 static void dvb_multi_destroy ( Dvb * );
 
 static char * dvb_time_to_str ( void )
@@ -99,12 +120,20 @@ static void dvb_message_dialog ( const char *f_error, const char *file_or_info,
 	gtk_widget_destroy ( GTK_WIDGET ( dialog ) );
 }
 
-static char * dvb_save_dialog ( const char *dir, const char *file, Dvb *dvb )
+static char * dvb_save_dialog ( const char *dir, const char *file, uint8_t *mode, Dvb *dvb )
 {
 	GtkWindow *window = GTK_WINDOW ( gtk_widget_get_toplevel ( GTK_WIDGET ( dvb ) ) );
 
 	GtkFileChooserDialog *dialog = ( GtkFileChooserDialog *)gtk_file_chooser_dialog_new ( " ", window, GTK_FILE_CHOOSER_ACTION_SAVE, "gtk-cancel", GTK_RESPONSE_CANCEL, "gtk-save", GTK_RESPONSE_ACCEPT, NULL );
 
+	GtkComboBoxText *combo_mode = (GtkComboBoxText *) gtk_combo_box_text_new ();
+
+	uint8_t c = 0; for ( c = 0; c < REC_NUM; c++ ) gtk_combo_box_text_append_text ( combo_mode, dvb_rec_mode_n[c] );
+
+	gtk_combo_box_set_active ( GTK_COMBO_BOX ( combo_mode ), *mode );
+	gtk_widget_set_visible ( GTK_WIDGET ( combo_mode ), TRUE );
+	gtk_file_chooser_set_extra_widget ( GTK_FILE_CHOOSER ( dialog ), GTK_WIDGET ( combo_mode ) );
+
 	gtk_window_set_icon_name ( GTK_WINDOW ( dialog ), "document-save" );
 	gtk_widget_set_opacity ( GTK_WIDGET ( dialog ), gtk_widget_get_opacity ( GTK_WIDGET ( window ) ) );
 
@@ -114,7 +143,12 @@ static char * dvb_save_dialog ( const char *dir, const char *file, Dvb *dvb )
 
 	char *filename = NULL;
 
-	if ( gtk_dialog_run ( GTK_DIALOG ( dialog ) ) == GTK_RESPONSE_ACCEPT ) filename = gtk_file_chooser_get_filename ( GTK_FILE_CHOOSER ( dialog ) );
+	if ( gtk_dialog_run ( GTK_DIALOG ( dialog ) ) == GTK_RESPONSE_ACCEPT )
+	{
+		filename = gtk_file_chooser_get_filename ( GTK_FILE_CHOOSER ( dialog ) );
+
+		*mode = (uint8_t)gtk_combo_box_get_active ( GTK_COMBO_BOX ( combo_mode ) );
+	}
 
 	gtk_widget_destroy ( GTK_WIDGET ( dialog ) );
 
@@ -125,8 +159,29 @@ static void dvb_set_stop ( Dvb *dvb )
 {
 	dvb->record = FALSE;
 
+	if ( dvb->tshift_tm ) g_source_remove ( dvb->tshift_tm );
+
+	dvb->tshift = NULL;
+	dvb->tshift_tm  = 0;
+	dvb->tshift_sel = NULL;
+	dvb->tshift_src = NULL;
+	dvb->tshift_pause = FALSE;
+
+	dvb->mosaic = NULL;
+
 	gst_element_set_state ( dvb->playdvb, GST_STATE_NULL );
 
+	if ( dvb->tuner ) dvb_pool_release ( dvb->tuner );
+
+	dvb->tuner = NULL;
+
+	if ( dvb->pad_rec ) gst_object_unref ( dvb->pad_rec );
+
+	dvb->recbin  = NULL;
+	dvb->recmux  = NULL;
+	dvb->recsink = NULL;
+	dvb->pad_rec = NULL;
+
 	gtk_widget_queue_draw ( GTK_WIDGET ( dvb ) );
 
 	if ( dvb->level && GTK_IS_WIDGET ( dvb->level ) ) g_signal_emit_by_name ( dvb->level, "level-update", 0, 0, FALSE, FALSE );
@@ -151,7 +206,24 @@ static void dvb_set_volume ( double val, Dvb *dvb )
 	g_object_set ( dvb->volume, "volume", val, NULL );
 }
 
-static void dvb_remove_bin ( GstElement *pipeline, const char *name )
+static gboolean dvb_remove_bin_keep ( GstElement *element, const char *object_name, const char * const *names, GstElement * const *elements )
+{
+	uint c = 0; for ( c = 0; elements && elements[c] != NULL; c++ )
+	{
+		if ( elements[c] == element ) return TRUE;
+	}
+
+	if ( names == NULL ) return FALSE;
+
+	for ( c = 0; names[c] != NULL; c++ )
+	{
+		if ( g_strrstr ( object_name, names[c] ) ) return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void dvb_remove_bin ( GstElement *pipeline, const char * const *names, GstElement * const *elements )
 {
 	GstIterator *it = gst_bin_iterate_elements ( GST_BIN ( pipeline ) );
 	GValue item = { 0, };
@@ -167,7 +239,7 @@ static void dvb_remove_bin ( GstElement *pipeline, const char *name )
 
 				char *object_name = gst_object_get_name ( GST_OBJECT ( element ) );
 
-				if ( name && g_strrstr ( object_name, name ) )
+				if ( dvb_remove_bin_keep ( element, object_name, names, elements ) )
 				{
 					g_debug ( "%s:: Object Not remove: %s \n", __func__, object_name );
 				}
@@ -368,39 +440,14 @@ static GObject * dvb_handler_combo_lang ( Dvb *dvb )
 	return G_OBJECT ( combo_lang );
 }
 
-static uint dvb_handler_getsid ( Dvb *dvb )
+static gpointer dvb_handler_pipeline ( Dvb *dvb )
 {
-	return dvb->sid;
+	return dvb->playdvb;
 }
 
-static gboolean dvb_pad_check_type ( GstPad *pad, const char *type )
-{
-	gboolean ret = FALSE;
-
-	GstCaps *caps = gst_pad_get_current_caps ( pad );
-
-	if ( !caps ) return FALSE;
-	if ( !GST_IS_CAPS ( caps ) ) return FALSE;
-
-	const char *name = gst_structure_get_name ( gst_caps_get_structure ( caps, 0 ) );
-
-	if ( name && g_str_has_prefix ( name, type ) ) ret = TRUE;
-
-	gst_caps_unref (caps);
-
-	return ret;
-}
-
-static void dvb_pad_link ( GstPad *pad, GstElement *element, const char *name )
+static uint dvb_handler_getsid ( Dvb *dvb )
 {
-	GstPad *pad_sink = gst_element_get_static_pad ( element, "sink" );
-
-	if ( gst_pad_link ( pad, pad_sink ) == GST_PAD_LINK_OK )
-		g_debug ( "%s:: linking Ok; %s", __func__, name );
-	else
-		g_debug ( "%s:: linking Failed; %s", __func__, name );
-
-	gst_object_unref ( pad_sink );
+	return dvb->sid;
 }
 
 static void dvb_add_pad_decode_audio ( G_GNUC_UNUSED GstElement *element, GstPad *pad, GstElement *el )
@@ -413,24 +460,31 @@ static void dvb_add_pad_decode_video ( G_GNUC_UNUSED GstElement *element, GstPad
 	dvb_pad_link ( pad, el, "decode video" );
 }
 
-static void dvb_create_elements_audio ( GstPad *pad, Dvb *dvb )
+static void dvb_decode_tile_added ( G_GNUC_UNUSED GstBin *bin, GstElement *element, G_GNUC_UNUSED Dvb *dvb )
 {
-	if ( dvb->first_audio ) return;
+	GObjectClass *oclass = G_OBJECT_GET_CLASS ( element );
+
+	/* avdec_*: skip B-frames, keep few threads per tile */
+	if ( g_object_class_find_property ( oclass, "skip-frame"  ) ) g_object_set ( element, "skip-frame",  1, NULL );
+	if ( g_object_class_find_property ( oclass, "max-threads" ) ) g_object_set ( element, "max-threads", 2, NULL );
+}
 
+static GstElement * dvb_create_dec_audio ( Dvb *dvb )
+{
 	const char *names[] = { "queue2", "decodebin", "audioconvert", "volume", "autoaudiosink" };
 
 	GstElement *elements[ G_N_ELEMENTS ( names ) ];
 
+	GstElement *bin = gst_bin_new ( "dec-audio" );
+
 	uint c = 0;
 	for ( c = 0; c < G_N_ELEMENTS ( names ); c++ )
 	{
 		elements[c] = gst_element_factory_make ( names[c], NULL );
 
-		if ( !elements[c] ) g_critical ( "%s:: element (factory make) - %s not created.", __func__, names[c] );
+		if ( !elements[c] ) { g_critical ( "%s:: element (factory make) - %s not created.", __func__, names[c] ); gst_object_unref ( bin ); return NULL; }
 
-		gst_bin_add ( GST_BIN ( dvb->playdvb ), elements[c] );
-
-		gst_element_set_state ( elements[c], GST_STATE_PLAYING );
+		gst_bin_add ( GST_BIN ( bin ), elements[c] );
 
 		if (  c == 0 || c == 2 ) continue;
 
@@ -439,33 +493,45 @@ static void dvb_create_elements_audio ( GstPad *pad, Dvb *dvb )
 
 	g_signal_connect ( elements[1], "pad-added", G_CALLBACK ( dvb_add_pad_decode_audio ), elements[2] );
 
-	dvb_pad_link ( pad, elements[0], "demux audio" );
+	if ( dvb->stats )
+	{
+		dvb_stats_queue ( dvb->stats, "queue2-audio", elements[0] );
+		dvb_stats_probe_added ( dvb->stats, "dec-audio", elements[1] );
+	}
+
+	GstPad *pad_host = gst_element_get_static_pad ( elements[0], "sink" );
+	gst_element_add_pad ( bin, gst_ghost_pad_new ( "sink", pad_host ) );
+	gst_object_unref ( pad_host );
 
 	dvb->volume = elements[3];
-	dvb->queue_audio = elements[0];
 
 	g_object_set ( dvb->volume, "mute",   FALSE, NULL );
 	g_object_set ( dvb->volume, "volume", dvb->volume_val, NULL );
 
-	dvb->first_audio = TRUE;
+	return gst_object_ref_sink ( bin );
 }
 
-static void dvb_create_elements_video ( GstPad *pad, Dvb *dvb )
+static GstElement * dvb_create_dec_video ( Dvb *dvb )
 {
-	const char *names[] = { "queue2", "decodebin", "videoconvert", "autovideosink" };
+	const char *names_main[] = { "queue2", "decodebin", "videoconvert", "autovideosink" };
+	const char *names_tile[] = { "queue2", "decodebin", "videoscale", "capsfilter", "videoconvert", "autovideosink" };
+	const char *names_stat[] = { "queue2", "decodebin", "videoconvert", "textoverlay", "videoconvert", "autovideosink" };
 
-	GstElement *elements[ G_N_ELEMENTS ( names ) ];
+	const char **names = ( dvb->win_count ) ? names_tile : ( dvb->stats ) ? names_stat : names_main;
+	uint num = ( dvb->win_count ) ? G_N_ELEMENTS ( names_tile ) : ( dvb->stats ) ? G_N_ELEMENTS ( names_stat ) : G_N_ELEMENTS ( names_main );
+
+	GstElement *elements[ G_N_ELEMENTS ( names_tile ) ];
+
+	GstElement *bin = gst_bin_new ( "dec-video" );
 
 	uint c = 0;
-	for ( c = 0; c < G_N_ELEMENTS ( names ); c++ )
+	for ( c = 0; c < num; c++ )
 	{
 		elements[c] = gst_element_factory_make ( names[c], NULL );
 
-		if ( !elements[c] ) g_critical ( "%s:: element (factory make) - %s not created.", __func__, names[c] );
-
-		gst_bin_add ( GST_BIN ( dvb->playdvb ), elements[c] );
+		if ( !elements[c] ) { g_critical ( "%s:: element (factory make) - %s not created.", __func__, names[c] ); gst_object_unref ( bin ); return NULL; }
 
-		gst_element_set_state ( elements[c], GST_STATE_PLAYING );
+		gst_bin_add ( GST_BIN ( bin ), elements[c] );
 
 		if (  c == 0 || c == 2 ) continue;
 
@@ -474,223 +540,278 @@ static void dvb_create_elements_video ( GstPad *pad, Dvb *dvb )
 
 	g_signal_connect ( elements[1], "pad-added", G_CALLBACK ( dvb_add_pad_decode_video ), elements[2] );
 
-	dvb_pad_link ( pad, elements[0], "demux video" );
+	if ( dvb->stats )
+	{
+		dvb_stats_queue ( dvb->stats, "queue2-video", elements[0] );
+		dvb_stats_probe_added ( dvb->stats, "dec-video", elements[1] );
+		dvb_stats_overlay ( dvb->stats, elements[3] );
+	}
 
-	dvb->set_video = TRUE;
+	if ( dvb->win_count )
+	{
+		GstCaps *caps = gst_caps_from_string ( "video/x-raw, width=(int)[ 16, 640 ], height=(int)[ 16, 360 ]" );
+		g_object_set ( elements[3], "caps", caps, NULL );
+		gst_caps_unref ( caps );
+
+		g_object_set ( elements[2], "method", 0, NULL );
+
+		g_signal_connect ( elements[1], "element-added", G_CALLBACK ( dvb_decode_tile_added ), dvb );
+	}
+
+	GstPad *pad_host = gst_element_get_static_pad ( elements[0], "sink" );
+	gst_element_add_pad ( bin, gst_ghost_pad_new ( "sink", pad_host ) );
+	gst_object_unref ( pad_host );
+
+	return gst_object_ref_sink ( bin );
 }
 
-static void dvb_add_pad_demux ( G_GNUC_UNUSED GstElement *element, GstPad *pad, Dvb *dvb )
+/* Made once and kept outside the pipeline: a demux pad adds its bin, a retune only removes it */
+static void dvb_create_dec ( Dvb *dvb )
 {
-	if ( dvb_pad_check_type ( pad, "audio" ) ) dvb_create_elements_audio ( pad, dvb );
-	if ( dvb_pad_check_type ( pad, "video" ) ) dvb_create_elements_video ( pad, dvb );
+	if ( !dvb->dec_audio ) dvb->dec_audio = dvb_create_dec_audio ( dvb );
+	if ( !dvb->dec_video ) dvb->dec_video = dvb_create_dec_video ( dvb );
+
+	dvb->queue_audio = dvb->dec_audio;
 }
 
-static void dvb_create_demux ( Dvb *dvb )
+/* An unlinked sink never prerolls: drop the bin the program has no stream for */
+static void dvb_dec_drop ( GstElement *pipeline, GstElement *dec )
 {
-	dvb->teerec = gst_element_factory_make ( "tee",     NULL );
-	dvb->demux  = gst_element_factory_make ( "tsdemux", NULL );
+	if ( !dec || GST_OBJECT_PARENT ( dec ) != GST_OBJECT ( pipeline ) ) return;
 
-	if ( !dvb->teerec || !dvb->demux ) { g_critical ( "%s:: dvbsrc ... - not created.", __func__ ); return; }
+	GstPad *pad_sink = gst_element_get_static_pad ( dec, "sink" );
 
-	gst_bin_add_many ( GST_BIN ( dvb->playdvb ), dvb->teerec, dvb->demux, NULL );
+	gboolean linked = gst_pad_is_linked ( pad_sink );
 
-	gst_element_link_many ( dvb->dvbsrc, dvb->teerec, dvb->demux, NULL );
+	gst_object_unref ( pad_sink );
 
-	g_signal_connect ( dvb->demux, "pad-added", G_CALLBACK ( dvb_add_pad_demux ), dvb );
+	if ( linked ) return;
+
+	gst_element_set_state ( dec, GST_STATE_NULL );
+	gst_bin_remove ( GST_BIN ( pipeline ), dec );
+
+	g_debug ( "%s:: %s ", __func__, GST_OBJECT_NAME ( dec ) );
 }
 
-static void dvb_create_bin ( Dvb *dvb )
+static void dvb_no_more_pads_demux ( G_GNUC_UNUSED GstElement *element, Dvb *dvb )
 {
-	dvb->dvbsrc = gst_element_factory_make ( "dvbsrc",  NULL );
+	dvb_dec_drop ( dvb->playdvb, dvb->dec_audio );
+	dvb_dec_drop ( dvb->playdvb, dvb->dec_video );
+}
 
-	if ( !dvb->dvbsrc ) { g_critical ( "%s:: dvbsrc ... - not created.", __func__ ); return; }
+static void dvb_dec_link ( GstPad *pad, GstElement *dec, GstElement *pipeline, const char *name )
+{
+	if ( !GST_OBJECT_PARENT ( dec ) ) gst_bin_add ( GST_BIN ( pipeline ), dec );
 
-	gst_bin_add ( GST_BIN ( dvb->playdvb ), dvb->dvbsrc );
+	GstCaps *caps = gst_pad_get_current_caps ( pad );
 
-	dvb_create_demux ( dvb );
+	const char *media = ( caps ) ? gst_structure_get_name ( gst_caps_get_structure ( caps, 0 ) ) : "";
+	const char *media_prev = g_object_get_data ( G_OBJECT ( dec ), "dec-media" );
 
-	gst_element_link ( dvb->dvbsrc, dvb->teerec );
-}
+	/* Same codec: the kept decoder just renegotiates */
+	if ( media_prev && !g_str_equal ( media, media_prev ) ) gst_element_set_state ( dec, GST_STATE_READY );
 
-static void dvb_create_bin_rm_rec ( Dvb *dvb )
-{
-	dvb_remove_bin ( dvb->playdvb, "dvbsrc" );
+	g_object_set_data_full ( G_OBJECT ( dec ), "dec-media", g_strdup ( media ), free );
 
-	dvb_create_demux ( dvb );
+	if ( caps ) gst_caps_unref ( caps );
 
-	g_object_set ( dvb->demux, "program-number", dvb->sid, NULL );
+	dvb_pad_link ( pad, dec, name );
+
+	gst_element_sync_state_with_parent ( dec );
 }
 
-static GstElementFactory * dvb_find_factory ( GstCaps *caps, guint64 num )
+static void dvb_create_elements_audio ( GstPad *pad, Dvb *dvb )
 {
-	GList *list, *list_filter;
-
-	static GMutex mutex;
-
-	g_mutex_lock ( &mutex );
-		list = gst_element_factory_list_get_elements ( num, GST_RANK_MARGINAL );
-		list_filter = gst_element_factory_list_filter ( list, caps, GST_PAD_SINK, gst_caps_is_fixed ( caps ) );
-	g_mutex_unlock ( &mutex );
+	if ( dvb->first_audio || !dvb->dec_audio ) return;
 
-	GstElementFactory *factory = GST_ELEMENT_FACTORY_CAST ( list_filter->data );
+	if ( dvb->stats ) dvb_stats_probe ( dvb->stats, "demux-audio", pad );
 
-	gst_plugin_feature_list_free ( list_filter );
-	gst_plugin_feature_list_free ( list );
+	dvb_dec_link ( pad, dvb->dec_audio, dvb->playdvb, "demux audio" );
 
-	return factory;
+	dvb->first_audio = TRUE;
 }
 
-static void dvb_typefind_parser ( GstElement *typefind, G_GNUC_UNUSED uint probability, GstCaps *caps, Dvb *dvb )
+static void dvb_create_elements_video ( GstPad *pad, Dvb *dvb )
 {
-	GstElementFactory *factory = dvb_find_factory ( caps, GST_ELEMENT_FACTORY_TYPE_PARSER );
+	if ( !dvb->dec_video ) return;
 
-	GstElement *element = gst_element_factory_create ( factory, NULL );
+	if ( dvb->stats ) dvb_stats_probe ( dvb->stats, "demux-video", pad );
 
-	gst_bin_add ( GST_BIN ( dvb->playdvb ), element );
+	dvb_dec_link ( pad, dvb->dec_video, dvb->playdvb, "demux video" );
 
-	gst_element_link_many ( typefind, element, dvb->recmux, NULL );
+	dvb->set_video = TRUE;
+}
 
-	gst_element_set_state ( element, GST_STATE_PLAYING );
+static void dvb_add_pad_demux ( G_GNUC_UNUSED GstElement *element, GstPad *pad, Dvb *dvb )
+{
+	if ( dvb_pad_check_type ( pad, "audio" ) ) dvb_create_elements_audio ( pad, dvb );
+	if ( dvb_pad_check_type ( pad, "video" ) ) dvb_create_elements_video ( pad, dvb );
 }
 
-static void dvb_create_elements_audio_video_rec ( GstPad *pad, const char *name, Dvb *dvb )
+static uint dvb_tshift_get_size ( void )
 {
-	GstElement *queue2   = gst_element_factory_make ( "queue2",   NULL );
-	GstElement *typefind = gst_element_factory_make ( "typefind", NULL );
+	GSettingsSchemaSource *schemasrc = g_settings_schema_source_get_default ();
+
+	GSettingsSchema *schema = ( schemasrc ) ? g_settings_schema_source_lookup ( schemasrc, "org.gnome.helia", FALSE ) : NULL;
 
-	if ( !queue2 || !typefind ) { g_critical ( "%s:: recbin ... - not created.", __func__ ); return; }
+	if ( schema == NULL ) return 0;
 
-	gst_bin_add_many ( GST_BIN ( dvb->playdvb ), queue2, typefind, NULL );
+	uint size = 0;
 
-	gst_element_link ( queue2, typefind );
+	if ( g_settings_schema_has_key ( schema, "timeshift" ) )
+	{
+		GSettings *setting = g_settings_new ( "org.gnome.helia" );
 
-	dvb_pad_link ( pad, queue2, g_str_has_prefix ( name, "audio" ) ? "demux-rec - audio" : "demux-rec - video" );
+		size = g_settings_get_uint ( setting, "timeshift" );
+
+		g_object_unref ( setting );
+	}
 
-	g_signal_connect ( typefind, "have-type", G_CALLBACK ( dvb_typefind_parser ), dvb );
+	g_settings_schema_unref ( schema );
 
-	gst_element_set_state ( queue2,   GST_STATE_PLAYING );
-	gst_element_set_state ( typefind, GST_STATE_PLAYING );
+	return size;
 }
 
-static void dvb_add_pad_demux_rec ( G_GNUC_UNUSED GstElement *element, GstPad *pad, Dvb *dvb )
+static void dvb_tshift_handoff ( G_GNUC_UNUSED GstElement *fakesink, GstBuffer *buffer, G_GNUC_UNUSED GstPad *pad, TShift *tshift )
 {
-	if ( dvb_pad_check_type ( pad, "audio" ) ) dvb_create_elements_audio_video_rec ( pad, "audio", dvb );
-	if ( dvb_pad_check_type ( pad, "video" ) ) dvb_create_elements_audio_video_rec ( pad, "video", dvb );
+	GstMapInfo map;
+
+	if ( !gst_buffer_map ( buffer, &map, GST_MAP_READ ) ) return;
+
+	tshift_write ( tshift, map.data, map.size );
+
+	gst_buffer_unmap ( buffer, &map );
 }
 
-static void dvb_create_rec ( const char *path, Dvb *dvb )
+static gboolean dvb_create_tshift ( Dvb *dvb )
 {
-	dvb->recmux   = gst_element_factory_make ( "mpegtsmux", NULL );
-	dvb->recdemux = gst_element_factory_make ( "tsdemux",   NULL );
+	uint size = dvb_tshift_get_size ();
 
-	GstElement *filesink = gst_element_factory_make ( "filesink", NULL );
+	if ( !size ) return FALSE;
 
-	if ( !dvb->recmux || !dvb->recdemux || !filesink ) { g_critical ( "%s:: recbin ... - not created. ", __func__ ); return; }
+	GstElement *queue    = gst_element_factory_make ( "queue",          NULL );
+	GstElement *fakesink = gst_element_factory_make ( "fakesink",       NULL );
+	GstElement *appsrc   = gst_element_factory_make ( "appsrc",         "tshift-src" );
+	GstElement *selector = gst_element_factory_make ( "input-selector", "tshift-selector" );
 
-	gst_bin_add_many ( GST_BIN ( dvb->playdvb ), dvb->recdemux, dvb->recmux, filesink, NULL );
+	if ( !queue || !fakesink || !appsrc || !selector ) { g_critical ( "%s:: appsrc ... - not created.", __func__ ); return FALSE; }
 
-	g_object_set ( dvb->recdemux, "program-number", dvb->sid, NULL );
-	g_object_set ( filesink, "location", path, NULL );
+	TShift *tshift = tshift_new ( size );
 
-	gst_element_link ( dvb->teerec, dvb->recdemux );
-	gst_element_link ( dvb->recmux, filesink );
+	if ( !tshift )
+	{
+		gst_object_unref ( queue    );
+		gst_object_unref ( fakesink );
+		gst_object_unref ( appsrc   );
+		gst_object_unref ( selector );
 
-	gst_element_set_state ( dvb->recdemux, GST_STATE_PLAYING );
-	gst_element_set_state ( dvb->recmux, GST_STATE_PLAYING );
-	gst_element_set_state ( filesink, GST_STATE_PLAYING );
+		return FALSE;
+	}
 
-	g_signal_connect ( dvb->recdemux, "pad-added", G_CALLBACK ( dvb_add_pad_demux_rec ), dvb );
-}
+	g_object_set ( queue, "leaky", 2, "max-size-buffers", 0, "max-size-time", (guint64)0, "max-size-bytes", 16 * 1024 * 1024, NULL );
+	g_object_set ( fakesink, "signal-handoffs", TRUE, "sync", FALSE, "async", FALSE, NULL );
 
-static void dvb_set_tuning_timeout ( GstElement *element )
-{
-	guint64 timeout = 0;
-	g_object_get ( element, "tuning-timeout", &timeout, NULL );
-	g_object_set ( element, "tuning-timeout", (guint64)timeout / 4, NULL );
-}
+	g_object_set_data_full ( G_OBJECT ( fakesink ), "tshift", tshift, (GDestroyNotify)tshift_free );
+	g_signal_connect ( fakesink, "handoff", G_CALLBACK ( dvb_tshift_handoff ), tshift );
 
-static void dvb_rinit ( GstElement *element )
-{
-	int adapter = 0, frontend = 0;
-	g_object_get ( element, "adapter",  &adapter,  NULL );
-	g_object_get ( element, "frontend", &frontend, NULL );
+	GstCaps *caps = gst_caps_from_string ( "video/mpegts, systemstream=(boolean)true, packetsize=(int)188" );
+	g_object_set ( appsrc, "caps", caps, "format", GST_FORMAT_TIME, "is-live", TRUE, "do-timestamp", TRUE, NULL );
+	gst_caps_unref ( caps );
+
+	g_object_set ( selector, "sync-streams", FALSE, NULL );
+
+	GstElement *bin = gst_bin_new ( "tshift-bin" );
 
-	g_autofree char *dvb_name = dvb_get_name ( adapter, frontend );
+	gst_bin_add_many ( GST_BIN ( bin ), queue, fakesink, NULL );
+	gst_element_link ( queue, fakesink );
 
-	g_debug ( "%s:: %s ", __func__, dvb_name );
+	GstPad *pad_host = gst_element_get_static_pad ( queue, "sink" );
+	gst_element_add_pad ( bin, gst_ghost_pad_new ( "sink", pad_host ) );
+	gst_object_unref ( pad_host );
+
+	gst_bin_add_many ( GST_BIN ( dvb->playdvb ), bin, appsrc, selector, NULL );
+
+	gst_element_link ( dvb->teerec, bin );
+	gst_element_link ( dvb->teerec, selector );
+	gst_element_link ( appsrc, selector );
+	gst_element_link ( selector, dvb->demux );
+
+	GstPad *pad_live = gst_element_get_static_pad ( selector, "sink_0" );
+	g_object_set ( selector, "active-pad", pad_live, NULL );
+	gst_object_unref ( pad_live );
+
+	dvb->tshift = tshift;
+	dvb->tshift_sel = selector;
+	dvb->tshift_src = appsrc;
+
+	return TRUE;
 }
 
-static RetSidLnb dvb_data_set ( const char *data, GstElement *element, GstElement *demux )
+static void dvb_create_demux ( Dvb *dvb )
 {
-	RetSidLnb sl;
-
-	sl.lnb = 0;
-	sl.sid = 0;
-	sl.lo_found = FALSE;
+	dvb->teerec = gst_element_factory_make ( "tee",     NULL );
+	dvb->demux  = gst_element_factory_make ( "tsdemux", NULL );
 
-	dvb_set_tuning_timeout ( element );
+	if ( !dvb->teerec || !dvb->demux ) { g_critical ( "%s:: dvbsrc ... - not created.", __func__ ); return; }
 
-	char **fields = g_strsplit ( data, ":", 0 );
-	uint j = 0, numfields = g_strv_length ( fields );
+	gst_bin_add_many ( GST_BIN ( dvb->playdvb ), dvb->teerec, dvb->demux, NULL );
 
-	for ( j = 1; j < numfields; j++ )
+	if ( dvb->stats )
 	{
-		if ( g_strrstr ( fields[j], "audio-pid" ) || g_strrstr ( fields[j], "video-pid" ) ) continue;
+		GstPad *pad = gst_element_get_static_pad ( dvb->teerec, "sink" );
+		dvb_stats_probe ( dvb->stats, "input", pad );
+		gst_object_unref ( pad );
+	}
 
-		if ( !g_strrstr ( fields[j], "=" ) ) continue;
+	gst_element_link ( dvb->dvbsrc, dvb->teerec );
 
-		char **splits = g_strsplit ( fields[j], "=", 0 );
+	if ( !dvb_create_tshift ( dvb ) ) gst_element_link ( dvb->teerec, dvb->demux );
 
-		g_debug ( "%s: gst-param %s | gst-value %s ", __func__, splits[0], splits[1] );
+	g_signal_connect ( dvb->demux, "pad-added", G_CALLBACK ( dvb_add_pad_demux ), dvb );
+	g_signal_connect ( dvb->demux, "no-more-pads", G_CALLBACK ( dvb_no_more_pads_demux ), dvb );
+}
 
-		if ( g_strrstr ( splits[0], "polarity" ) )
-		{
-			if ( splits[1][0] == 'v' || splits[1][0] == 'V' || splits[1][0] == '0' )
-				g_object_set ( element, "polarity", "V", NULL );
-			else
-				g_object_set ( element, "polarity", "H", NULL );
+static void dvb_create_bin ( Dvb *dvb )
+{
+	dvb->dvbsrc = ts_file_make_src ();
 
-			g_strfreev (splits);
+	if ( !dvb->dvbsrc ) { g_critical ( "%s:: dvbsrc ... - not created.", __func__ ); return; }
 
-			continue;
-		}
+	gst_bin_add ( GST_BIN ( dvb->playdvb ), dvb->dvbsrc );
 
-		long dat = atol ( splits[1] );
+	dvb_create_demux ( dvb );
+	dvb_create_dec ( dvb );
 
-		if ( g_strrstr ( splits[0], "program-number" ) )
-		{
-			sl.sid = (uint16_t)dat;
-			g_object_set ( demux, "program-number", dat, NULL );
-		}
-		else if ( g_strrstr ( splits[0], "symbol-rate" ) )
-		{
-			g_object_set ( element, "symbol-rate", ( dat > 1000000 ) ? dat / 1000 : dat, NULL );
-		}
-		else if ( g_strrstr ( splits[0], "lnb-type" ) )
-		{
-			sl.lnb = (uint8_t)dat;
+	gst_element_link ( dvb->dvbsrc, dvb->teerec );
+}
 
-			if ( g_strrstr ( data, "lnb-lof" ) ) sl.lo_found = TRUE;
+static gboolean dvb_create_rec ( const char *path, uint8_t mode, Dvb *dvb )
+{
+	GstElement *recmux = NULL, *recsink = NULL;
 
-			Descr *descr = descr_new ();
+	GstElement *recbin = dvb_rec_create_bin ( path, mode, dvb->sid, dvb->tp_key, &recmux, &recsink );
 
-			g_signal_emit_by_name ( descr, "descr-lnbs", (uint)dat, element );
+	if ( !recbin ) return FALSE;
 
-			g_object_unref ( descr );
-		}
-		else
-		{
-			g_object_set ( element, splits[0], dat, NULL );
-		}
+	dvb->pad_rec = dvb_rec_attach ( dvb->teerec, recbin );
 
-		g_strfreev (splits);
-	}
+	if ( !dvb->pad_rec ) return FALSE;
 
-	g_strfreev (fields);
+	dvb->recbin  = recbin;
+	dvb->recmux  = recmux;
+	dvb->recsink = recsink;
 
-	dvb_rinit ( element );
+	return TRUE;
+}
+
+static void dvb_rec_stop ( Dvb *dvb )
+{
+	dvb_rec_detach ( dvb->teerec, dvb->recbin, dvb->recmux, dvb->recsink, dvb->pad_rec, NULL, NULL );
 
-	return sl;
+	dvb->recbin  = NULL;
+	dvb->recmux  = NULL;
+	dvb->recsink = NULL;
+	dvb->pad_rec = NULL;
 }
 
 static void dvb_play ( Dvb *dvb )
@@ -783,6 +904,161 @@ static void dvb_lnb_win ( GstElement *element, Dvb *dvb )
 	gtk_window_present ( window );
 }
 
+static void dvb_tshift_set_active ( const char *name, Dvb *dvb )
+{
+	GstPad *pad = gst_element_get_static_pad ( dvb->tshift_sel, name );
+
+	g_object_set ( dvb->tshift_sel, "active-pad", pad, NULL );
+
+	gst_object_unref ( pad );
+}
+
+static void dvb_tshift_live ( Dvb *dvb )
+{
+	if ( dvb->tshift_tm ) g_source_remove ( dvb->tshift_tm );
+
+	dvb->tshift_tm = 0;
+	dvb->tshift_pause = FALSE;
+
+	tshift_set_live ( dvb->tshift );
+
+	dvb_tshift_set_active ( "sink_0", dvb );
+}
+
+static gboolean dvb_tshift_push ( Dvb *dvb )
+{
+	gint64 time_cur = g_get_monotonic_time ();
+	gint64 elapsed  = time_cur - dvb->tshift_time;
+
+	dvb->tshift_time = time_cur;
+
+	if ( dvb->tshift_pause ) return TRUE;
+
+	size_t size = 0, max = TS_PACKET_SIZE * 1024;
+
+	do
+	{
+		GstMapInfo map;
+		GstBuffer *buffer = gst_buffer_new_allocate ( NULL, max, NULL );
+
+		gst_buffer_map ( buffer, &map, GST_MAP_WRITE );
+		size = tshift_read ( dvb->tshift, map.data, map.size, elapsed );
+		gst_buffer_unmap ( buffer, &map );
+
+		elapsed = 0;
+
+		if ( size )
+		{
+			GstFlowReturn ret;
+
+			gst_buffer_set_size ( buffer, size );
+			g_signal_emit_by_name ( dvb->tshift_src, "push-buffer", buffer, &ret );
+		}
+
+		gst_buffer_unref ( buffer );
+
+	} while ( size == max );
+
+	if ( !tshift_is_live ( dvb->tshift ) ) return TRUE;
+
+	dvb->tshift_tm = 0;
+
+	dvb_tshift_live ( dvb );
+
+	return FALSE;
+}
+
+static void dvb_tshift_start ( Dvb *dvb )
+{
+	if ( dvb->tshift_tm ) return;
+
+	dvb_tshift_set_active ( "sink_1", dvb );
+
+	dvb->tshift_time = g_get_monotonic_time ();
+	dvb->tshift_tm = g_timeout_add ( 40, (GSourceFunc)dvb_tshift_push, dvb );
+}
+
+static void dvb_tshift_seek ( int sec, Dvb *dvb )
+{
+	if ( !dvb->tshift || GST_ELEMENT_CAST ( dvb->playdvb )->current_state != GST_STATE_PLAYING ) return;
+
+	if ( tshift_seek ( dvb->tshift, sec ) )
+		{ if ( dvb->tshift_tm ) dvb_tshift_live ( dvb ); }
+	else
+		dvb_tshift_start ( dvb );
+}
+
+static void dvb_tshift_pause ( Dvb *dvb )
+{
+	if ( !dvb->tshift || GST_ELEMENT_CAST ( dvb->playdvb )->current_state != GST_STATE_PLAYING ) return;
+
+	if ( !dvb->tshift_tm ) { dvb->tshift_pause = TRUE; dvb_tshift_seek ( 0, dvb ); return; }
+
+	dvb->tshift_pause = !dvb->tshift_pause;
+}
+
+static GstPadProbeReturn dvb_zap_probe ( GstPad *pad, G_GNUC_UNUSED GstPadProbeInfo *info, Dvb *dvb )
+{
+	const char *keep[] = { "rec-bin", "tshift", "dec-", "mosaic-", "pipeline-dvb-", NULL };
+	GstElement *keep_el[] = { dvb->dvbsrc, dvb->teerec, NULL };
+
+	dvb_remove_bin ( dvb->playdvb, keep, keep_el );
+
+	dvb->set_video = FALSE;
+	dvb->first_audio = FALSE;
+
+	dvb->demux = gst_element_factory_make ( "tsdemux", NULL );
+
+	if ( !dvb->demux ) { g_critical ( "%s:: tsdemux - not created.", __func__ ); return GST_PAD_PROBE_REMOVE; }
+
+	gst_bin_add ( GST_BIN ( dvb->playdvb ), dvb->demux );
+
+	g_object_set ( dvb->demux, "program-number", dvb->sid, NULL );
+	g_signal_connect ( dvb->demux, "pad-added", G_CALLBACK ( dvb_add_pad_demux ), dvb );
+	g_signal_connect ( dvb->demux, "no-more-pads", G_CALLBACK ( dvb_no_more_pads_demux ), dvb );
+
+	dvb_pad_link ( pad, dvb->demux, "tee zap" );
+
+	gst_element_sync_state_with_parent ( dvb->demux );
+
+	return GST_PAD_PROBE_REMOVE;
+}
+
+static gboolean dvb_zap ( const char *data, Dvb *dvb )
+{
+	if ( GST_ELEMENT_CAST ( dvb->playdvb )->current_state != GST_STATE_PLAYING ) return FALSE;
+
+	if ( !dvb->demux || !dvb->tp_key ) return FALSE;
+
+	g_autofree char *tp_key = dvb_get_tp_key ( data );
+
+	if ( !g_str_equal ( tp_key, dvb->tp_key ) ) return FALSE;
+
+	GstPad *pad_sink = gst_element_get_static_pad ( dvb->demux, "sink" );
+	GstPad *pad_tee  = gst_pad_get_peer ( pad_sink );
+
+	gst_object_unref ( pad_sink );
+
+	if ( !pad_tee ) return FALSE;
+
+	uint16_t sid = dvb_get_sid ( data );
+
+	g_debug ( "%s:: same transponder, sid %u -> %u ", __func__, dvb->sid, sid );
+
+	if ( sid != dvb->sid )
+	{
+		dvb->sid = sid;
+
+		if ( dvb->tshift_tm ) dvb_tshift_live ( dvb );
+
+		gst_pad_add_probe ( pad_tee, GST_PAD_PROBE_TYPE_IDLE, (GstPadProbeCallback)dvb_zap_probe, dvb, NULL );
+	}
+
+	gst_object_unref ( pad_tee );
+
+	return TRUE;
+}
+
 static void dvb_stop_set_play ( const char *data, Dvb *dvb )
 {
 	double value = 1.0;
@@ -790,15 +1066,17 @@ static void dvb_stop_set_play ( const char *data, Dvb *dvb )
 
 	dvb->volume_val = value;
 
-	dvb_set_stop ( dvb );
-	dvb_remove_bin ( dvb->playdvb, NULL );
+	if ( dvb_zap ( data, dvb ) ) return;
 
-	dvb->volume = NULL;
+	dvb_set_stop ( dvb );
+	dvb_remove_bin ( dvb->playdvb, NULL, NULL );
 
 	dvb->record = FALSE;
 	dvb->set_video = FALSE;
 	dvb->first_audio = FALSE;
 
+	if ( dvb->stats ) dvb_stats_reset ( dvb->stats );
+
 	dvb_create_bin ( dvb );
 
 	if ( !dvb->dvbsrc ) return;
@@ -806,6 +1084,15 @@ static void dvb_stop_set_play ( const char *data, Dvb *dvb )
 	RetSidLnb sl = dvb_data_set ( data, dvb->dvbsrc, dvb->demux );
 	dvb->sid = sl.sid;
 
+	dvb->tuner = dvb_pool_acquire ( data );
+
+	if ( dvb->tuner ) dvb_pool_set_dvbsrc ( dvb->tuner, dvb->dvbsrc ); else g_warning ( "%s:: no free tuner in the pool. ", __func__ );
+
+	free ( dvb->tp_key );
+	dvb->tp_key = dvb_get_tp_key ( data );
+
+	epg_forget ( dvb->tp_key );
+
 	if ( sl.lnb == LNB_MNL && !sl.lo_found ) { dvb_lnb_win ( dvb->dvbsrc, dvb ); return; }
 
 	dvb_play ( dvb );
@@ -818,13 +1105,8 @@ static void dvb_rec ( Dvb *dvb )
 	if ( dvb->record )
 	{
 		dvb->record = FALSE;
-		dvb->first_audio = FALSE;
 
-		gst_element_set_state ( dvb->playdvb, GST_STATE_NULL );
-
-		dvb_create_bin_rm_rec ( dvb );
-
-		gst_element_set_state ( dvb->playdvb, GST_STATE_PLAYING );
+		if ( dvb->recbin ) dvb_rec_stop ( dvb );
 	}
 	else
 	{
@@ -833,16 +1115,16 @@ static void dvb_rec ( Dvb *dvb )
 		char file[PATH_MAX];
 		sprintf ( file, "Record-Dvb-%s.m2ts", dt );
 
-		g_autofree char *path = dvb_save_dialog ( dvb->rec_dir, file, dvb );
+		g_autofree char *path = dvb_save_dialog ( dvb->rec_dir, file, &dvb->rec_mode, dvb );
 
 		if ( path == NULL ) return;
 
 		free ( dvb->rec_dir );
 		dvb->rec_dir = g_path_get_dirname ( path );
 
-		dvb_create_rec ( path, dvb );
+		dvb->record = dvb_create_rec ( path, dvb->rec_mode, dvb );
 
-		dvb->record = TRUE;
+		if ( !dvb->record ) dvb_message_dialog ( path, "Record not started.", GTK_MESSAGE_ERROR, dvb );
 	}
 }
 
@@ -864,6 +1146,12 @@ static GstBusSyncReply dvb_sync_handler ( G_GNUC_UNUSED GstBus *bus, GstMessage
 
 static void dvb_msg_all ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, Dvb *dvb )
 {
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ELEMENT ) dvb_rec_index_section ( msg );
+
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ELEMENT && dvb->tp_key ) epg_section ( dvb->tp_key, msg );
+
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_QOS && dvb->stats ) dvb_stats_message ( dvb->stats, msg );
+
 	const GstStructure *structure = gst_message_get_structure ( msg );
 
 	if ( structure && dvb->level )
@@ -912,6 +1200,8 @@ static GstElement * dvb_create ( Dvb *dvb )
 
 	if ( dvb->win_count ) return dvbplay;
 
+	dvb->stats = dvb_stats_new ();
+
 	GstBus *bus = gst_element_get_bus ( dvbplay );
 
 	gst_bus_add_signal_watch_full ( bus, G_PRIORITY_DEFAULT );
@@ -961,6 +1251,14 @@ static gboolean dvb_video_press_event ( GtkDrawingArea *draw, GdkEventButton *ev
 	return GDK_EVENT_PROPAGATE;
 }
 
+static gboolean dvb_video_scroll_event ( G_GNUC_UNUSED GtkDrawingArea *draw, GdkEventScroll *event, Dvb *dvb )
+{
+	if ( event->direction == GDK_SCROLL_UP   ) dvb_tshift_seek (  10, dvb );
+	if ( event->direction == GDK_SCROLL_DOWN ) dvb_tshift_seek ( -10, dvb );
+
+	return GDK_EVENT_STOP;
+}
+
 static void dvb_show_cursor ( GtkDrawingArea *draw, gboolean show_cursor )
 {
 	GdkWindow *window = gtk_widget_get_window ( GTK_WIDGET ( draw ) );
@@ -1053,13 +1351,14 @@ static void dvb_create_video ( Dvb *dvb )
 	GtkDrawingArea *video = GTK_DRAWING_AREA ( dvb );
 
 	gtk_widget_set_visible ( GTK_WIDGET ( video ), TRUE );
-	gtk_widget_set_events ( GTK_WIDGET ( video ), GDK_BUTTON_PRESS_MASK | GDK_POINTER_MOTION_MASK );
+	gtk_widget_set_events ( GTK_WIDGET ( video ), GDK_BUTTON_PRESS_MASK | GDK_POINTER_MOTION_MASK | GDK_SCROLL_MASK );
 
 	g_signal_connect ( video, "draw",    G_CALLBACK ( dvb_video_draw    ), dvb );
 	g_signal_connect ( video, "realize", G_CALLBACK ( dvb_video_realize ), dvb );
 
 	g_signal_connect ( video, "button-press-event",  G_CALLBACK ( dvb_video_press_event  ), dvb );
 	g_signal_connect ( video, "motion-notify-event", G_CALLBACK ( dvb_video_notify_event ), dvb );
+	g_signal_connect ( video, "scroll-event",        G_CALLBACK ( dvb_video_scroll_event ), dvb );
 }
 
 static gboolean dvb_handler_isplay ( Dvb *dvb )
@@ -1084,40 +1383,24 @@ static void dvb_handler_rec ( Dvb *dvb )
 	dvb_rec ( dvb );
 }
 
-static void dvb_handler_mute ( Dvb *dvb )
+static void dvb_handler_pause ( Dvb *dvb )
 {
-	if ( GST_ELEMENT_CAST ( dvb->playdvb )->current_state != GST_STATE_NULL ) dvb_set_mute ( dvb );
+	dvb_tshift_pause ( dvb );
 }
 
-static void dvb_handler_vol ( Dvb *dvb, double val )
+static void dvb_handler_seek ( Dvb *dvb, int sec )
 {
-	if ( GST_ELEMENT_CAST ( dvb->playdvb )->current_state != GST_STATE_NULL ) dvb_set_volume ( val, dvb );
+	dvb_tshift_seek ( sec, dvb );
 }
 
-static uint16_t dvb_get_sid ( const char *data )
+static void dvb_handler_mute ( Dvb *dvb )
 {
-	uint16_t ret = 0;
-
-	char **fields = g_strsplit ( data, ":", 0 );
-	uint j = 0, numfields = g_strv_length ( fields );
-
-	for ( j = 1; j < numfields; j++ )
-	{
-		if ( g_strrstr ( fields[j], "program-number" ) )
-		{
-			char **splits = g_strsplit ( fields[j], "=", 0 );
-
-			g_debug ( "%s: gst-param %s | gst-value %s ", __func__, splits[0], splits[1] );
-
-			ret = (uint16_t)atoi ( splits[1] );
-
-			g_strfreev ( splits );
-		}
-	}
-
-	g_strfreev ( fields );
+	if ( GST_ELEMENT_CAST ( dvb->playdvb )->current_state != GST_STATE_NULL ) dvb_set_mute ( dvb );
+}
 
-	return ret;
+static void dvb_handler_vol ( Dvb *dvb, double val )
+{
+	if ( GST_ELEMENT_CAST ( dvb->playdvb )->current_state != GST_STATE_NULL ) dvb_set_volume ( val, dvb );
 }
 
 static void dvb_create_bin_multi ( uint16_t sid, Dvb *dvb )
@@ -1131,6 +1414,8 @@ static void dvb_create_bin_multi ( uint16_t sid, Dvb *dvb )
 
 	gst_element_link_many ( queue2, dvb->demux, NULL );
 
+	dvb_create_dec ( dvb );
+
 	g_object_set ( dvb->demux, "program-number", sid, NULL );
 
 	GstPad *pad_host = gst_element_get_static_pad ( queue2, "sink" );
@@ -1138,17 +1423,51 @@ static void dvb_create_bin_multi ( uint16_t sid, Dvb *dvb )
 	gst_object_unref ( pad_host );
 
 	g_signal_connect ( dvb->demux, "pad-added", G_CALLBACK ( dvb_add_pad_demux ), dvb );
+	g_signal_connect ( dvb->demux, "no-more-pads", G_CALLBACK ( dvb_no_more_pads_demux ), dvb );
+}
+
+static GstElement * dvb_mosaic_get ( Dvb *dvb )
+{
+	if ( dvb->mosaic ) return dvb->mosaic;
+
+	GstElement *queue   = gst_element_factory_make ( "queue",   "mosaic-queue" );
+	GstElement *tsparse = gst_element_factory_make ( "tsparse", "mosaic-parse" );
+
+	if ( !queue || !tsparse ) { g_critical ( "%s:: tsparse ... - not created.", __func__ ); return NULL; }
+
+	g_object_set ( queue, "max-size-buffers", 0, "max-size-time", (guint64)0, "max-size-bytes", 16 * 1024 * 1024, NULL );
+
+	gst_bin_add_many ( GST_BIN ( dvb->playdvb ), queue, tsparse, NULL );
+	gst_element_link_many ( dvb->teerec, queue, tsparse, NULL );
+
+	gst_element_sync_state_with_parent ( queue   );
+	gst_element_sync_state_with_parent ( tsparse );
+
+	dvb->mosaic = tsparse;
+
+	return tsparse;
 }
 
 static void dvb_multi_destroy ( Dvb *dvb )
 {
-	gst_element_unlink ( dvb->tee_base, dvb->playdvb );
+	if ( dvb->pad_multi )
+	{
+		GstPad *pad_sink = gst_element_get_static_pad ( dvb->playdvb, "sink" );
+
+		gst_pad_unlink ( dvb->pad_multi, pad_sink );
+		gst_element_release_request_pad ( dvb->tee_base, dvb->pad_multi );
+
+		gst_object_unref ( dvb->pad_multi );
+		gst_object_unref ( pad_sink );
+
+		dvb->pad_multi = NULL;
+	}
 
 	gst_element_set_state ( dvb->playdvb, GST_STATE_NULL );
 
-	GstElement *element = GST_ELEMENT ( gst_element_get_parent ( dvb->tee_base ) );
+	GstObject *parent = gst_object_get_parent ( GST_OBJECT ( dvb->playdvb ) );
 
-	gst_bin_remove ( GST_BIN ( element ), dvb->playdvb );
+	if ( parent ) { gst_bin_remove ( GST_BIN ( parent ), dvb->playdvb ); gst_object_unref ( parent ); }
 
 	g_signal_emit_by_name ( dvb, "dvb-base", 99 );
 
@@ -1169,15 +1488,26 @@ static void dvb_handler_multi ( Dvb *dvb, const char *data, gpointer base_dvb )
 	dvb->set_video = FALSE;
 	dvb->first_audio = FALSE;
 
-	dvb->tee_base = dvb_base->teerec;
+	dvb->tee_base = dvb_mosaic_get ( dvb_base );
+
+	if ( !dvb->tee_base ) return;
 
 	uint16_t sid = dvb_get_sid ( data );
+
+	char name[20];
+	sprintf ( name, "program_%u", sid );
+
+	dvb->pad_multi = gst_element_get_request_pad ( dvb->tee_base, name );
+
+	if ( !dvb->pad_multi ) { g_warning ( "%s:: %s - already shown. ", __func__, name ); return; }
+
 	dvb_create_bin_multi ( sid, dvb );
 
 	gst_element_set_state ( dvb->playdvb, GST_STATE_PLAYING );
 
 	gst_bin_add ( GST_BIN ( dvb_base->playdvb ), dvb->playdvb );
-	gst_element_link ( dvb_base->teerec, dvb->playdvb );
+
+	dvb_pad_link ( dvb->pad_multi, dvb->playdvb, "mosaic" );
 }
 
 static void dvb_init ( Dvb *dvb )
@@ -1185,10 +1515,32 @@ static void dvb_init ( Dvb *dvb )
 	dvb->sid = 0;
 	dvb->xid = 0;
 
+	dvb->demux  = NULL;
 	dvb->dvbsrc = NULL;
 	dvb->volume = NULL;
+	dvb->tp_key = NULL;
 	dvb->record = FALSE;
 
+	dvb->recbin  = NULL;
+	dvb->recmux  = NULL;
+	dvb->recsink = NULL;
+	dvb->pad_rec = NULL;
+
+	dvb->tshift = NULL;
+	dvb->tshift_tm  = 0;
+	dvb->tshift_sel = NULL;
+	dvb->tshift_src = NULL;
+	dvb->tshift_pause = FALSE;
+
+	dvb->tuner = NULL;
+
+	dvb->mosaic = NULL;
+	dvb->pad_multi = NULL;
+
+	dvb->dec_audio = NULL;
+	dvb->dec_video = NULL;
+
+	dvb->rec_mode = REC_REMUX;
 	dvb->rec_dir = g_strdup ( g_get_home_dir () );
 
 	dvb_create_video ( dvb );
@@ -1198,8 +1550,11 @@ static void dvb_init ( Dvb *dvb )
 	g_signal_connect ( dvb, "dvb-stop", G_CALLBACK ( dvb_handler_stop ), NULL );
 	g_signal_connect ( dvb, "dvb-mute", G_CALLBACK ( dvb_handler_mute ), NULL );
 	g_signal_connect ( dvb, "dvb-vol",  G_CALLBACK ( dvb_handler_vol  ), NULL );
+	g_signal_connect ( dvb, "dvb-seek", G_CALLBACK ( dvb_handler_seek ), NULL );
+	g_signal_connect ( dvb, "dvb-pause", G_CALLBACK ( dvb_handler_pause ), NULL );
 
 	g_signal_connect ( dvb, "dvb-get-sid", G_CALLBACK ( dvb_handler_getsid ), NULL );
+	g_signal_connect ( dvb, "dvb-get-pipeline", G_CALLBACK ( dvb_handler_pipeline ), NULL );
 	g_signal_connect ( dvb, "dvb-is-play", G_CALLBACK ( dvb_handler_isplay ), NULL );
 	g_signal_connect ( dvb, "dvb-combo-lang", G_CALLBACK ( dvb_handler_combo_lang ), NULL );
 
@@ -1212,9 +1567,11 @@ static void dvb_finalize ( GObject *object )
 {
 	Dvb *dvb = DVB_DRAW ( object );
 
+	free ( dvb->tp_key );
 	free ( dvb->rec_dir );
 
 	if ( dvb->src_tm ) g_source_remove ( dvb->src_tm );
+	if ( dvb->tshift_tm ) g_source_remove ( dvb->tshift_tm );
 
 	if ( !dvb->win_count && GST_IS_ELEMENT ( dvb->playdvb ) )
 	{
@@ -1222,6 +1579,13 @@ static void dvb_finalize ( GObject *object )
 		gst_object_unref ( dvb->playdvb );
 	}
 
+	if ( dvb->dec_audio ) gst_object_unref ( dvb->dec_audio );
+	if ( dvb->dec_video ) gst_object_unref ( dvb->dec_video );
+
+	if ( dvb->stats ) dvb_stats_free ( dvb->stats );
+
+	if ( dvb->tuner ) dvb_pool_release ( dvb->tuner );
+
 	G_OBJECT_CLASS (dvb_parent_class)->finalize (object);
 }
 
@@ -1237,8 +1601,11 @@ static void dvb_class_init ( DvbClass *class )
 	g_signal_new ( "dvb-play", G_TYPE_FROM_CLASS ( class ), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_STRING );
 	g_signal_new ( "dvb-vol",  G_TYPE_FROM_CLASS ( class ), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_DOUBLE );
 	g_signal_new ( "dvb-base", G_TYPE_FROM_CLASS ( class ), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_UINT   );
+	g_signal_new ( "dvb-seek", G_TYPE_FROM_CLASS ( class ), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_INT    );
+	g_signal_new ( "dvb-pause", G_TYPE_FROM_CLASS ( class ), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 0 );
 
 	g_signal_new ( "dvb-get-sid",    G_TYPE_FROM_CLASS ( class ), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_UINT,    0 );
+	g_signal_new ( "dvb-get-pipeline", G_TYPE_FROM_CLASS ( class ), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_POINTER, 0 );
 	g_signal_new ( "dvb-combo-lang", G_TYPE_FROM_CLASS ( class ), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_OBJECT,  0 );
 	g_signal_new ( "dvb-is-play",    G_TYPE_FROM_CLASS ( class ), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_BOOLEAN, 0 );
 	g_signal_new ( "dvb-icon-scan-info", G_TYPE_FROM_CLASS ( class ), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_BOOLEAN );
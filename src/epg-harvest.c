@@ -0,0 +1,260 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "epg-harvest.h"
+#include "epg.h"
+#include "dvb-pool.h"
+#include "dvb-tune.h"
+#include "ts-file.h"
+
+#include <stdlib.h>
+
+/* Budget: tuners used at once, seconds between two transponders, seconds before one is harvested again */
+#define EPG_HARVEST_TUNERS 2
+#define EPG_HARVEST_REST   30
+#define EPG_HARVEST_CYCLE  ( 4 * 3600 )
+
+/* Seconds on a transponder: at most, and without a new EIT section */
+#define EPG_HARVEST_DWELL  120
+#define EPG_HARVEST_QUIET  20
+
+#define EPG_HARVEST_TUNE_MS 5000
+
+/* PAT, SDT, EIT and TDT only: the demux drops the rest in the driver */
+#define EPG_HARVEST_PIDS "0:17:18:20"
+
+typedef struct _EpgTp EpgTp;
+
+struct _EpgTp
+{
+	char *data;
+	gint64 last;
+
+	gboolean busy;
+};
+
+typedef struct _EpgJob EpgJob;
+
+struct _EpgJob
+{
+	EpgTp *tp;
+	EpgHarvest *harvest;
+
+	DvbTuner *tuner;
+	GstElement *pipeline;
+
+	gint64 start;
+	gint64 update;
+
+	uint bus_id;
+	uint src_tm;
+};
+
+struct _EpgHarvest
+{
+	GPtrArray *tps;
+	GHashTable *keys;
+	GPtrArray *jobs;
+
+	uint next;
+	uint src_tm;
+};
+
+static void epg_tp_free ( EpgTp *tp )
+{
+	free ( tp->data );
+	free ( tp );
+}
+
+static void epg_job_stop ( EpgJob *job, gboolean release )
+{
+	if ( job->bus_id ) g_source_remove ( job->bus_id );
+	if ( job->src_tm ) g_source_remove ( job->src_tm );
+
+	dvb_pool_stop ( job->pipeline );
+	gst_object_unref ( job->pipeline );
+
+	if ( release ) dvb_pool_release ( job->tuner );
+
+	g_debug ( "%s:: %s %s ", __func__, job->tp->data, ( release ) ? "" : "( preempted )" );
+
+	job->tp->busy = FALSE;
+	job->tp->last = g_get_monotonic_time () / G_USEC_PER_SEC;
+
+	g_ptr_array_remove_fast ( job->harvest->jobs, job );
+
+	free ( job );
+}
+
+/* A foreground user took the tuner */
+static void epg_job_preempt ( EpgJob *job )
+{
+	epg_job_stop ( job, FALSE );
+}
+
+static gboolean epg_job_check ( EpgJob *job )
+{
+	gint64 now = g_get_monotonic_time () / G_USEC_PER_SEC;
+
+	if ( now - job->start < EPG_HARVEST_DWELL && now - job->update < EPG_HARVEST_QUIET ) return G_SOURCE_CONTINUE;
+
+	job->src_tm = 0;
+
+	epg_job_stop ( job, TRUE );
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean epg_job_bus ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, EpgJob *job )
+{
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ELEMENT )
+	{
+		const DvbChan *chan = dvb_chan_get ( job->tp->data );
+
+		if ( epg_section ( chan->tp_key, msg ) ) job->update = g_get_monotonic_time () / G_USEC_PER_SEC;
+	}
+
+	if ( GST_MESSAGE_TYPE ( msg ) != GST_MESSAGE_ERROR ) return G_SOURCE_CONTINUE;
+
+	GError *err = NULL;
+	gst_message_parse_error ( msg, &err, NULL );
+
+	g_debug ( "%s:: %s: %s ", __func__, job->tp->data, err->message );
+
+	g_error_free ( err );
+
+	job->bus_id = 0;
+
+	epg_job_stop ( job, TRUE );
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean epg_job_start ( EpgTp *tp, EpgHarvest *harvest )
+{
+	EpgJob *job = g_new0 ( EpgJob, 1 );
+
+	job->tuner = dvb_pool_acquire_idle ( tp->data, (DvbPreempt)epg_job_preempt, job );
+
+	if ( !job->tuner ) { free ( job ); return FALSE; }
+
+	epg_forget ( dvb_chan_get ( tp->data )->tp_key );
+
+	GstElement *pipeline = gst_pipeline_new ( NULL );
+	GstElement *dvbsrc   = ts_file_make_src ();
+	GstElement *tsparse  = gst_element_factory_make ( "tsparse",  NULL );
+	GstElement *fakesink = gst_element_factory_make ( "fakesink", NULL );
+
+	if ( !pipeline || !dvbsrc || !tsparse || !fakesink )
+	{
+		g_critical ( "%s:: pipeline harvest - not be created.", __func__ );
+
+		dvb_pool_release ( job->tuner );
+		free ( job );
+
+		return FALSE;
+	}
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), dvbsrc, tsparse, fakesink, NULL );
+	gst_element_link_many ( dvbsrc, tsparse, fakesink, NULL );
+
+	dvb_data_set ( tp->data, dvbsrc, NULL );
+
+	dvb_pool_set_dvbsrc ( job->tuner, dvbsrc );
+
+	g_object_set ( dvbsrc, "pids", EPG_HARVEST_PIDS, "tuning-timeout", (guint64)EPG_HARVEST_TUNE_MS * GST_MSECOND, NULL );
+	g_object_set ( fakesink, "sync", FALSE, NULL );
+
+	job->tp = tp;
+	job->harvest  = harvest;
+	job->pipeline = pipeline;
+	job->start    = g_get_monotonic_time () / G_USEC_PER_SEC;
+	job->update   = job->start + EPG_HARVEST_TUNE_MS / 1000;
+
+	tp->busy = TRUE;
+
+	GstBus *bus = gst_element_get_bus ( pipeline );
+	job->bus_id = gst_bus_add_watch ( bus, (GstBusFunc)epg_job_bus, job );
+	gst_object_unref ( bus );
+
+	job->src_tm = g_timeout_add_seconds ( 5, (GSourceFunc)epg_job_check, job );
+
+	g_ptr_array_add ( harvest->jobs, job );
+
+	g_debug ( "%s:: %s ", __func__, tp->data );
+
+	dvb_pool_play ( pipeline );
+
+	return TRUE;
+}
+
+static gboolean epg_harvest_next ( EpgHarvest *harvest )
+{
+	gint64 now = g_get_monotonic_time () / G_USEC_PER_SEC;
+
+	uint n = 0; for ( n = 0; n < harvest->tps->len && harvest->jobs->len < EPG_HARVEST_TUNERS; n++ )
+	{
+		EpgTp *tp = g_ptr_array_index ( harvest->tps, harvest->next );
+
+		harvest->next = ( harvest->next + 1 ) % harvest->tps->len;
+
+		if ( tp->busy || ( tp->last && now - tp->last < EPG_HARVEST_CYCLE ) ) continue;
+
+		/* No idle tuner for this one: wait for the next round */
+		if ( !epg_job_start ( tp, harvest ) ) break;
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+EpgHarvest * epg_harvest_new ( void )
+{
+	EpgHarvest *harvest = g_new0 ( EpgHarvest, 1 );
+
+	harvest->tps  = g_ptr_array_new_with_free_func ( (GDestroyNotify)epg_tp_free );
+	harvest->keys = g_hash_table_new_full ( g_str_hash, g_str_equal, free, NULL );
+	harvest->jobs = g_ptr_array_new ();
+
+	return harvest;
+}
+
+/* One entry per transponder: the first channel line gives the tuning data */
+void epg_harvest_add ( EpgHarvest *harvest, const char *data )
+{
+	const DvbChan *chan = dvb_chan_get ( data );
+
+	if ( g_hash_table_contains ( harvest->keys, chan->tp_key ) ) return;
+
+	g_hash_table_add ( harvest->keys, g_strdup ( chan->tp_key ) );
+
+	EpgTp *tp = g_new0 ( EpgTp, 1 );
+	tp->data = g_strdup ( data );
+
+	g_ptr_array_add ( harvest->tps, tp );
+}
+
+void epg_harvest_start ( EpgHarvest *harvest )
+{
+	if ( harvest->src_tm ) return;
+
+	harvest->src_tm = g_timeout_add_seconds ( EPG_HARVEST_REST, (GSourceFunc)epg_harvest_next, harvest );
+}
+
+void epg_harvest_free ( EpgHarvest *harvest )
+{
+	if ( harvest->src_tm ) g_source_remove ( harvest->src_tm );
+
+	while ( harvest->jobs->len ) epg_job_stop ( g_ptr_array_index ( harvest->jobs, 0 ), TRUE );
+
+	g_ptr_array_unref ( harvest->jobs );
+	g_ptr_array_unref ( harvest->tps );
+	g_hash_table_unref ( harvest->keys );
+
+	free ( harvest );
+}
@@ -0,0 +1,22 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+
+typedef struct _EpgHarvest EpgHarvest;
+
+EpgHarvest * epg_harvest_new ( void );
+
+void epg_harvest_add ( EpgHarvest *, const char * );
+
+void epg_harvest_start ( EpgHarvest * );
+
+void epg_harvest_free ( EpgHarvest * );
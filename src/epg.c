@@ -0,0 +1,399 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "epg.h"
+#include "dvb-tune.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/mpegts/mpegts.h>
+
+/* Events that ended this long ago are dropped when the store is loaded */
+#define EPG_KEEP_PAST ( 3 * 3600 )
+
+/* The log is rewritten on load once it holds this many times the live events */
+#define EPG_COMPACT 2
+
+static GHashTable *epg_services = NULL;
+static GHashTable *epg_versions = NULL;
+
+static FILE *epg_log = NULL;
+static GMutex epg_mutex;
+
+static void epg_event_free_data ( EpgEvent *event )
+{
+	free ( event->title );
+	free ( event->desc );
+}
+
+static char * epg_key ( uint16_t sid, const char *tp_key )
+{
+	return g_strdup_printf ( "%u#%s", sid, tp_key );
+}
+
+static char * epg_strip ( const char *text )
+{
+	char *ret = g_strdup ( ( text ) ? text : "" );
+
+	uint i = 0; for ( i = 0; ret[i] != '\0'; i++ )
+	{
+		if ( ret[i] == '\t' || ret[i] == '\n' || ret[i] == '\r' ) ret[i] = ' ';
+	}
+
+	return ret;
+}
+
+/* First event starting after time */
+static uint epg_upper ( GArray *events, gint64 time )
+{
+	uint lo = 0, hi = events->len;
+
+	while ( lo < hi )
+	{
+		uint mid = ( lo + hi ) / 2;
+
+		if ( g_array_index ( events, EpgEvent, mid ).start <= time ) lo = mid + 1; else hi = mid;
+	}
+
+	return lo;
+}
+
+/* Inserts the event in start order, replacing the events it overlaps; FALSE if it is already there */
+static gboolean epg_insert ( GHashTable *services, const char *key, EpgEvent *event )
+{
+	GArray *events = g_hash_table_lookup ( services, key );
+
+	if ( !events )
+	{
+		events = g_array_new ( FALSE, FALSE, sizeof ( EpgEvent ) );
+		g_array_set_clear_func ( events, (GDestroyNotify)epg_event_free_data );
+
+		g_hash_table_insert ( services, g_strdup ( key ), events );
+	}
+
+	gint64 end = event->start + event->duration;
+
+	uint i = epg_upper ( events, event->start );
+
+	if ( i > 0 )
+	{
+		const EpgEvent *prev = &g_array_index ( events, EpgEvent, i - 1 );
+
+		if ( prev->start == event->start && prev->duration == event->duration && prev->event_id == event->event_id
+			&& g_str_equal ( prev->title, event->title ) && g_str_equal ( prev->desc, event->desc ) )
+		{
+			epg_event_free_data ( event );
+
+			return FALSE;
+		}
+
+		if ( prev->start + prev->duration > event->start ) i--;
+	}
+
+	uint n = i; while ( n < events->len && g_array_index ( events, EpgEvent, n ).start < end ) n++;
+
+	if ( n > i ) g_array_remove_range ( events, i, n - i );
+
+	g_array_insert_val ( events, i, *event );
+
+	return TRUE;
+}
+
+static void epg_append ( const char *key, const EpgEvent *event )
+{
+	if ( !epg_log ) return;
+
+	fprintf ( epg_log, "%s\t%u\t%" G_GINT64_FORMAT "\t%u\t%s\t%s\n", key, event->event_id, event->start, event->duration, event->title, event->desc );
+}
+
+static uint epg_load ( GHashTable *services, const char *path )
+{
+	char *contents = NULL;
+
+	if ( !g_file_get_contents ( path, &contents, NULL, NULL ) ) return 0;
+
+	gint64 old = g_get_real_time () / G_USEC_PER_SEC - EPG_KEEP_PAST;
+
+	char **lines = g_strsplit ( contents, "\n", 0 );
+	uint j = 0, num = 0;
+
+	for ( j = 0; lines[j]; j++ )
+	{
+		char **fields = g_strsplit ( lines[j], "\t", 6 );
+
+		if ( g_strv_length ( fields ) == 6 )
+		{
+			EpgEvent event = { 0 };
+
+			event.event_id = (uint16_t)atoi ( fields[1] );
+			event.start    = g_ascii_strtoll ( fields[2], NULL, 10 );
+			event.duration = (uint)atoi ( fields[3] );
+
+			if ( event.start + event.duration >= old )
+			{
+				event.title = g_strdup ( fields[4] );
+				event.desc  = g_strdup ( fields[5] );
+
+				epg_insert ( services, fields[0], &event );
+			}
+
+			num++;
+		}
+
+		g_strfreev ( fields );
+	}
+
+	g_strfreev ( lines );
+	free ( contents );
+
+	return num;
+}
+
+static void epg_compact ( GHashTable *services, const char *path )
+{
+	GString *gstring = g_string_new ( NULL );
+
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init ( &iter, services );
+
+	while ( g_hash_table_iter_next ( &iter, &key, &value ) )
+	{
+		GArray *events = value;
+
+		uint i = 0; for ( i = 0; i < events->len; i++ )
+		{
+			const EpgEvent *event = &g_array_index ( events, EpgEvent, i );
+
+			g_string_append_printf ( gstring, "%s\t%u\t%" G_GINT64_FORMAT "\t%u\t%s\t%s\n", (char *)key, event->event_id, event->start, event->duration, event->title, event->desc );
+		}
+	}
+
+	GError *err = NULL;
+
+	if ( !g_file_set_contents ( path, gstring->str, (gssize)gstring->len, &err ) )
+	{
+		g_warning ( "%s:: %s ", __func__, err->message );
+		g_error_free ( err );
+	}
+
+	g_string_free ( gstring, TRUE );
+}
+
+/* Runs once, off the main loop: sections and lookups are ignored until the store is in place */
+static gpointer epg_init ( G_GNUC_UNUSED gpointer data )
+{
+	GHashTable *services = g_hash_table_new_full ( g_str_hash, g_str_equal, free, (GDestroyNotify)g_array_unref );
+
+	char path[PATH_MAX];
+	sprintf ( path, "%s/helia/epg.log", g_get_user_config_dir () );
+
+	uint num = epg_load ( services, path ), live = 0;
+
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init ( &iter, services );
+
+	while ( g_hash_table_iter_next ( &iter, NULL, &value ) ) live += ( (GArray *)value )->len;
+
+	if ( num > live * EPG_COMPACT ) epg_compact ( services, path );
+
+	g_debug ( "%s:: %u records, %u events ", __func__, num, live );
+
+	FILE *log = fopen ( path, "a" );
+
+	if ( !log ) g_warning ( "%s:: %s: not opened. ", __func__, path );
+
+	g_mutex_lock ( &epg_mutex );
+
+	epg_services = services;
+	epg_versions = g_hash_table_new_full ( g_str_hash, g_str_equal, free, (GDestroyNotify)g_hash_table_unref );
+	epg_log = log;
+
+	g_mutex_unlock ( &epg_mutex );
+
+	return NULL;
+}
+
+void epg_start ( void )
+{
+	gst_mpegts_initialize ();
+
+	g_thread_unref ( g_thread_new ( "epg-load", epg_init, NULL ) );
+}
+
+/* A new pass over a transponder handles all its sections again: the versions seen stay bounded */
+void epg_forget ( const char *tp_key )
+{
+	g_mutex_lock ( &epg_mutex );
+
+	if ( epg_versions ) g_hash_table_remove ( epg_versions, tp_key );
+
+	g_mutex_unlock ( &epg_mutex );
+}
+
+/* TRUE if this version of the section has been handled already */
+static gboolean epg_seen ( GstMpegtsSection *section, const char *tp_key )
+{
+	GHashTable *versions = g_hash_table_lookup ( epg_versions, tp_key );
+
+	if ( !versions )
+	{
+		versions = g_hash_table_new_full ( g_str_hash, g_str_equal, free, NULL );
+
+		g_hash_table_insert ( epg_versions, g_strdup ( tp_key ), versions );
+	}
+
+	char *key = g_strdup_printf ( "%u:%u:%u", section->subtable_extension, section->table_id, section->section_number );
+
+	gpointer version = GUINT_TO_POINTER ( section->version_number + 1u );
+
+	if ( g_hash_table_lookup ( versions, key ) == version ) { free ( key ); return TRUE; }
+
+	g_hash_table_insert ( versions, key, version );
+
+	return FALSE;
+}
+
+static void epg_event_text ( GstMpegtsEITEvent *eit_event, EpgEvent *event )
+{
+	uint i = 0; for ( i = 0; i < eit_event->descriptors->len; i++ )
+	{
+		GstMpegtsDescriptor *desc = g_ptr_array_index ( eit_event->descriptors, i );
+
+		char *lang = NULL, *name = NULL, *text = NULL;
+
+		if ( desc->tag != GST_MTS_DESC_DVB_SHORT_EVENT ) continue;
+
+		if ( !gst_mpegts_descriptor_parse_dvb_short_event ( desc, &lang, &name, &text ) ) continue;
+
+		if ( !event->title ) { event->title = epg_strip ( name ); event->desc = epg_strip ( text ); }
+
+		free ( lang );
+		free ( name );
+		free ( text );
+	}
+
+	if ( !event->title ) event->title = g_strdup ( "" );
+	if ( !event->desc  ) event->desc  = g_strdup ( "" );
+}
+
+static void epg_eit ( GstMpegtsSection *section, const char *tp_key )
+{
+	const GstMpegtsEIT *eit = gst_mpegts_section_get_eit ( section );
+
+	if ( !eit ) return;
+
+	g_autofree char *key = epg_key ( section->subtable_extension, tp_key );
+
+	uint i = 0, num = 0;
+
+	for ( i = 0; i < eit->events->len; i++ )
+	{
+		GstMpegtsEITEvent *eit_event = g_ptr_array_index ( eit->events, i );
+
+		if ( !eit_event->start_time ) continue;
+
+		GDateTime *date = gst_date_time_to_g_date_time ( eit_event->start_time );
+
+		if ( !date ) continue;
+
+		EpgEvent event = { 0 };
+
+		event.start    = g_date_time_to_unix ( date );
+		event.duration = eit_event->duration;
+		event.event_id = eit_event->event_id;
+
+		g_date_time_unref ( date );
+
+		epg_event_text ( eit_event, &event );
+
+		if ( epg_insert ( epg_services, key, &event ) ) { epg_append ( key, &event ); num++; }
+	}
+
+	if ( num && epg_log ) fflush ( epg_log );
+}
+
+/* EIT actual only: p/f 0x4E and schedule 0x50-0x5F; other-TS tables cannot be matched to a channel line.
+   Returns TRUE for a section version not handled before */
+gboolean epg_section ( const char *tp_key, GstMessage *msg )
+{
+	GstMpegtsSection *section = gst_message_parse_mpegts_section ( msg );
+
+	if ( !section ) return FALSE;
+
+	gboolean ret = FALSE;
+
+	if ( GST_MPEGTS_SECTION_TYPE ( section ) == GST_MPEGTS_SECTION_EIT
+		&& ( section->table_id == 0x4E || ( section->table_id >= 0x50 && section->table_id <= 0x5F ) ) )
+	{
+		g_mutex_lock ( &epg_mutex );
+
+		if ( epg_services && !epg_seen ( section, tp_key ) ) { epg_eit ( section, tp_key ); ret = TRUE; }
+
+		g_mutex_unlock ( &epg_mutex );
+	}
+
+	gst_mpegts_section_unref ( section );
+
+	return ret;
+}
+
+gboolean epg_get_event ( const char *data, gint64 time, uint8_t when, EpgEvent *event )
+{
+	const DvbChan *chan = dvb_chan_get ( data );
+
+	g_autofree char *key = epg_key ( chan->sid, chan->tp_key );
+
+	gboolean ret = FALSE;
+
+	g_mutex_lock ( &epg_mutex );
+
+	GArray *events = ( epg_services ) ? g_hash_table_lookup ( epg_services, key ) : NULL;
+
+	if ( events )
+	{
+		uint i = epg_upper ( events, time );
+
+		/* i - 1 started before time: now if it has not ended yet */
+		gboolean now = ( i > 0 && g_array_index ( events, EpgEvent, i - 1 ).start + g_array_index ( events, EpgEvent, i - 1 ).duration > time );
+
+		uint n = ( when == EPG_NOW ) ? i - 1 : i;
+
+		if ( ( when == EPG_NOW && now ) || ( when == EPG_NEXT && i < events->len ) )
+		{
+			const EpgEvent *found = &g_array_index ( events, EpgEvent, n );
+
+			*event = *found;
+
+			event->title = g_strdup ( found->title );
+			event->desc  = g_strdup ( found->desc  );
+
+			ret = TRUE;
+		}
+	}
+
+	g_mutex_unlock ( &epg_mutex );
+
+	return ret;
+}
+
+void epg_event_clear ( EpgEvent *event )
+{
+	epg_event_free_data ( event );
+
+	event->title = NULL;
+	event->desc  = NULL;
+}
@@ -0,0 +1,40 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+
+enum EpgWhen
+{
+	EPG_NOW,
+	EPG_NEXT
+};
+
+typedef struct _EpgEvent EpgEvent;
+
+struct _EpgEvent
+{
+	gint64 start;
+	uint duration;
+	uint16_t event_id;
+
+	char *title;
+	char *desc;
+};
+
+void epg_start ( void );
+
+void epg_forget ( const char * );
+
+gboolean epg_section ( const char *, GstMessage * );
+
+gboolean epg_get_event ( const char *, gint64, uint8_t, EpgEvent * );
+
+void epg_event_clear ( EpgEvent * );
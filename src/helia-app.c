@@ -9,6 +9,7 @@
 
 #include "helia-app.h"
 #include "helia-win.h"
+#include "epg.h"
 
 #include <gst/gst.h>
 
@@ -29,6 +30,8 @@ static void helia_app_activate ( GApplication *app )
 static void helia_app_init ( G_GNUC_UNUSED HeliaApp *helia_app )
 {
 	gst_init ( NULL, NULL );
+
+	epg_start ();
 }
 
 static void helia_app_finalize ( GObject *object )
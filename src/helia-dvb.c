@@ -30,7 +30,7 @@ struct _HeliaDvb
 	GtkBox *hbox_video_a;
 	GtkBox *hbox_video_b;
 
-	GtkButton *button[4];
+	GtkButton *button[6];
 
 	GtkWindow *win_base;
 
@@ -91,6 +91,11 @@ static void helia_dvb_record ( G_GNUC_UNUSED GtkButton *button, HeliaDvb *dvb )
 	g_signal_emit_by_name ( dvb->video, "dvb-rec" );
 }
 
+static void helia_dvb_pause ( G_GNUC_UNUSED GtkButton *button, HeliaDvb *dvb )
+{
+	g_signal_emit_by_name ( dvb->video, "dvb-pause" );
+}
+
 static void helia_dvb_volume_changed ( G_GNUC_UNUSED GtkScaleButton *button, double value, HeliaDvb *dvb )
 {
 	g_signal_emit_by_name ( dvb->video, "dvb-vol", value );
@@ -107,8 +112,8 @@ static GtkBox * helia_dvb_create_control ( HeliaDvb *dvb )
 	gtk_scale_button_set_value ( GTK_SCALE_BUTTON ( volbutton ), 1.0 );
 	g_signal_connect ( volbutton, "value-changed", G_CALLBACK ( helia_dvb_volume_changed ), dvb );
 
-	const char *icons[] = { "helia-stop", "helia-record", "helia-display", NULL, "helia-pref" };
-	fpd funcs[] = { helia_dvb_stop, helia_dvb_record, helia_dvb_info, NULL, helia_dvb_pref };
+	const char *icons[] = { "helia-stop", "helia-record", "helia-play", "helia-display", NULL, "helia-pref" };
+	fpd funcs[] = { helia_dvb_stop, helia_dvb_record, helia_dvb_pause, helia_dvb_info, NULL, helia_dvb_pref };
 
 	uint8_t c = 0; for ( c = 0; c < G_N_ELEMENTS ( icons ); c++ )
 	{
@@ -198,7 +203,7 @@ static void helia_dvb_handler_base ( G_GNUC_UNUSED Dvb *d, uint num, HeliaDvb *d
 static void helia_dvb_handler_icon ( G_GNUC_UNUSED Dvb *d, gboolean play, HeliaDvb *dvb )
 {
 	GtkImage *image = helia_dvb_create_image ( ( play ) ? "helia-info" : "helia-display", 16 );
-	gtk_button_set_image ( dvb->button[2], GTK_WIDGET ( image ) );
+	gtk_button_set_image ( dvb->button[3], GTK_WIDGET ( image ) );
 }
 
 static void helia_dvb_handler_play ( G_GNUC_UNUSED TreeDvb *td, const char *data, HeliaDvb *dvb )
@@ -210,7 +215,7 @@ static void helia_dvb_handler_play ( G_GNUC_UNUSED TreeDvb *td, const char *data
 
 static void helia_dvb_handler_multi ( G_GNUC_UNUSED TreeDvb *td, const char *data, HeliaDvb *dvb )
 {
-	if ( dvb->multi_destroy || dvb->win_count >= 3 ) return;
+	if ( dvb->multi_destroy || dvb->win_count == UINT8_MAX ) return;
 
 	gboolean play = FALSE;
 	g_signal_emit_by_name ( dvb->video, "dvb-is-play", &play );
@@ -222,7 +227,7 @@ static void helia_dvb_handler_multi ( G_GNUC_UNUSED TreeDvb *td, const char *dat
 	Dvb *video_add = dvb_new ( dvb->win_count, NULL );
 	g_signal_connect ( video_add, "dvb-base", G_CALLBACK ( helia_dvb_handler_base ), dvb );
 
-	if ( dvb->win_count < 2 )
+	if ( helia_dvb_multi_get_box_w_n ( dvb->hbox_video_a ) <= helia_dvb_multi_get_box_w_n ( dvb->hbox_video_b ) )
 	{
 		gtk_box_pack_start ( dvb->hbox_video_a, GTK_WIDGET ( video_add ), TRUE, TRUE, 0 );
 	}
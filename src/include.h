@@ -37,3 +37,11 @@ enum Lnbs
 	LNB_BRO,
 	LNB_MNL
 };
+
+enum RecMode
+{
+	REC_REMUX,
+	REC_PASS,
+	REC_MPTS,
+	REC_NUM
+};
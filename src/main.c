@@ -7,15 +7,21 @@
 * http://www.gnu.org/licenses/gpl-3.0.html
 */
 
+#include "ts-rec.h"
+#include "rec-cli.h"
 #include "helia-app.h"
 
-int main ( void )
+int main ( int argc, char **argv )
 {
+	if ( argc > 1 && ( g_str_equal ( argv[1], "--record" ) || g_str_equal ( argv[1], "--schedule" ) ) ) return rec_cli_run ( argc, argv );
+
 	HeliaApp *app = helia_app_new ();
 
 	int status = g_application_run ( G_APPLICATION ( app ), 0, NULL );
 
 	g_object_unref ( app );
 
+	ts_rec_wait ();
+
 	return status;
 }
@@ -35,6 +35,20 @@ static GSettings * settings_init ( void )
 	return setting;
 }
 
+static gboolean pref_has_key ( Pref *pref, const char *key )
+{
+	if ( pref->setting == NULL ) return FALSE;
+
+	GSettingsSchema *schema = NULL;
+	g_object_get ( pref->setting, "settings-schema", &schema, NULL );
+
+	gboolean ret = ( schema && g_settings_schema_has_key ( schema, key ) );
+
+	if ( schema ) g_settings_schema_unref ( schema );
+
+	return ret;
+}
+
 static void pref_set_def ( GtkWindow *window, Pref *pref )
 {
 	if ( pref->setting == NULL )
@@ -105,6 +119,18 @@ static void pref_spinbutton_changed_opacity_win ( GtkSpinButton *button, Pref *p
 	gtk_widget_set_opacity ( GTK_WIDGET ( window ), (double)opacity / 100 );
 }
 
+static void pref_spinbutton_changed_tshift ( GtkSpinButton *button, Pref *pref )
+{
+	uint size = (uint)gtk_spin_button_get_value_as_int ( button );
+
+	if ( pref_has_key ( pref, "timeshift" ) ) g_settings_set_uint ( pref->setting, "timeshift", size );
+}
+
+static void pref_toggled_harvest ( GtkToggleButton *button, Pref *pref )
+{
+	if ( pref_has_key ( pref, "epg-harvest" ) ) g_settings_set_boolean ( pref->setting, "epg-harvest", gtk_toggle_button_get_active ( button ) );
+}
+
 static GtkBox * pref_create_spinbutton ( uint val, uint8_t min, uint32_t max, uint8_t step, const char *icon, void ( *f )( GtkSpinButton *, Pref * ), Pref *pref )
 {
 	GtkBox *hbox = (GtkBox *)gtk_box_new ( GTK_ORIENTATION_HORIZONTAL, 0 );
@@ -201,9 +227,22 @@ static void pref_init ( Pref *pref )
 	gtk_box_set_spacing ( vbox, 3 );
 	gtk_widget_set_visible ( GTK_WIDGET ( vbox ), TRUE );
 
+	uint tshift = ( pref_has_key ( pref, "timeshift" ) ) ? g_settings_get_uint ( pref->setting, "timeshift" ) : 0;
+
 	gtk_box_pack_start ( vbox, GTK_WIDGET ( pref_create_spinbutton     ( 100, 40, 100, 1, "helia-window", pref_spinbutton_changed_opacity_win, pref ) ), FALSE, FALSE, 0 );
+	gtk_box_pack_start ( vbox, GTK_WIDGET ( pref_create_spinbutton     ( tshift, 0, 16384, 64, "helia-record", pref_spinbutton_changed_tshift, pref ) ), FALSE, FALSE, 0 );
 	gtk_box_pack_start ( vbox, GTK_WIDGET ( pref_create_chooser_button ( "Theme", "helia-theme", "/usr/share/themes/", pref_changed_theme, pref ) ), FALSE, FALSE, 0 );
 
+	if ( pref_has_key ( pref, "epg-harvest" ) )
+	{
+		GtkCheckButton *harvest = (GtkCheckButton *)gtk_check_button_new_with_label ( "EPG on idle tuners" );
+		gtk_toggle_button_set_active ( GTK_TOGGLE_BUTTON ( harvest ), g_settings_get_boolean ( pref->setting, "epg-harvest" ) );
+		g_signal_connect ( harvest, "toggled", G_CALLBACK ( pref_toggled_harvest ), pref );
+		gtk_widget_set_visible ( GTK_WIDGET ( harvest ), TRUE );
+
+		gtk_box_pack_start ( vbox, GTK_WIDGET ( harvest ), FALSE, FALSE, 0 );
+	}
+
 	GtkBox *hbox = (GtkBox *)gtk_box_new ( GTK_ORIENTATION_HORIZONTAL, 0 );
 	gtk_box_set_spacing ( hbox, 5 );
 	gtk_widget_set_visible ( GTK_WIDGET ( hbox ), TRUE );
@@ -0,0 +1,188 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "rec-cli.h"
+#include "include.h"
+#include "dvb-rec.h"
+#include "dvb-pool.h"
+#include "dvb-tune.h"
+#include "rec-sched.h"
+#include "ts-rec.h"
+#include "ts-file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <gst/gst.h>
+#include <glib-unix.h>
+
+static volatile sig_atomic_t rec_cli_quit = 0;
+
+static void rec_cli_signal ( G_GNUC_UNUSED int sig )
+{
+	rec_cli_quit = 1;
+}
+
+static void rec_cli_usage ( const char *prog )
+{
+	fprintf ( stderr, "Usage: %s --record \"<gtv-channel.conf line>\" <seconds> <file> [ remux | pass | mpts ]\n", prog );
+	fprintf ( stderr, "       %s --schedule <schedule.conf>\n", prog );
+	fprintf ( stderr, "HELIA_TS_FILE=<file | -> replays a captured transponder instead of a tuner, HELIA_TS_PACE=fast without the PCR pace.\n" );
+}
+
+static gboolean rec_cli_wait ( GstBus *bus, gint64 time_end, gboolean wait_eos )
+{
+	while ( wait_eos || !rec_cli_quit )
+	{
+		gint64 time_cur = g_get_monotonic_time ();
+
+		if ( time_cur >= time_end ) return TRUE;
+
+		GstClockTime timeout = (GstClockTime)MIN ( time_end - time_cur, G_USEC_PER_SEC / 2 ) * GST_USECOND;
+
+		GstMessage *msg = gst_bus_timed_pop_filtered ( bus, timeout, GST_MESSAGE_ERROR | GST_MESSAGE_EOS | GST_MESSAGE_ELEMENT );
+
+		if ( !msg ) continue;
+
+		GstMessageType type = GST_MESSAGE_TYPE ( msg );
+
+		if ( type == GST_MESSAGE_ELEMENT ) dvb_rec_index_section ( msg );
+
+		if ( type == GST_MESSAGE_ERROR )
+		{
+			GError *err = NULL;
+			char *dbg = NULL;
+
+			gst_message_parse_error ( msg, &err, &dbg );
+
+			fprintf ( stderr, "%s\n", err->message );
+			if ( dbg ) g_debug ( "%s:: %s ", __func__, dbg );
+
+			g_error_free ( err );
+			free ( dbg );
+		}
+
+		gst_message_unref ( msg );
+
+		if ( type == GST_MESSAGE_ERROR ) return FALSE;
+		if ( type == GST_MESSAGE_EOS   ) return TRUE;
+	}
+
+	return TRUE;
+}
+
+static int rec_cli_record ( const char *data, uint duration, const char *path, uint8_t mode )
+{
+	g_autofree char *tp_key = dvb_get_tp_key ( data );
+
+	GstElement *recmux = NULL, *recsink = NULL;
+	GstElement *recbin = dvb_rec_create_bin ( path, mode, dvb_get_sid ( data ), tp_key, &recmux, &recsink );
+
+	GstElement *dvbsrc = ts_file_make_src ();
+
+	if ( !recbin || !dvbsrc )
+	{
+		if ( recbin ) gst_object_unref ( recbin );
+		if ( dvbsrc ) gst_object_unref ( dvbsrc );
+
+		fprintf ( stderr, "%s: record not started.\n", path );
+
+		return 1;
+	}
+
+	GstElement *pipeline = gst_pipeline_new ( "pipeline-rec" );
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), dvbsrc, recbin, NULL );
+	gst_element_link ( dvbsrc, recbin );
+
+	RetSidLnb sl = dvb_data_set ( data, dvbsrc, NULL );
+
+	DvbTuner *tuner = dvb_pool_acquire ( data );
+
+	if ( tuner ) dvb_pool_set_dvbsrc ( tuner, dvbsrc );
+
+	if ( sl.lnb == LNB_MNL && !sl.lo_found ) fprintf ( stderr, "Manual LNB without lnb-lof1/lnb-lof2/lnb-slof, using defaults.\n" );
+
+	GstBus *bus = gst_element_get_bus ( pipeline );
+
+	gst_element_set_state ( pipeline, GST_STATE_PLAYING );
+
+	gboolean ret = rec_cli_wait ( bus, g_get_monotonic_time () + (gint64)duration * G_USEC_PER_SEC, FALSE );
+
+	if ( ret )
+	{
+		gst_element_send_event ( pipeline, gst_event_new_eos () );
+
+		ret = rec_cli_wait ( bus, g_get_monotonic_time () + 5 * G_USEC_PER_SEC, TRUE );
+	}
+
+	gst_element_set_state ( pipeline, GST_STATE_NULL );
+
+	gst_object_unref ( bus );
+	gst_object_unref ( pipeline );
+
+	if ( tuner ) dvb_pool_release ( tuner );
+
+	ts_rec_wait ();
+
+	return ( ret ) ? 0 : 1;
+}
+
+static gboolean rec_cli_sched_quit ( RecSched *sched )
+{
+	rec_sched_cancel ( sched );
+
+	return G_SOURCE_CONTINUE;
+}
+
+static int rec_cli_schedule ( const char *file )
+{
+	GMainLoop *loop = g_main_loop_new ( NULL, FALSE );
+
+	RecSched *sched = rec_sched_new ( (GDestroyNotify)g_main_loop_quit, loop );
+
+	uint num = rec_sched_load ( sched, file );
+
+	if ( num )
+	{
+		uint sig_int  = g_unix_signal_add ( SIGINT,  (GSourceFunc)rec_cli_sched_quit, sched );
+		uint sig_term = g_unix_signal_add ( SIGTERM, (GSourceFunc)rec_cli_sched_quit, sched );
+
+		g_main_loop_run ( loop );
+
+		g_source_remove ( sig_int  );
+		g_source_remove ( sig_term );
+	}
+
+	rec_sched_free ( sched );
+	g_main_loop_unref ( loop );
+
+	ts_rec_wait ();
+
+	return ( num ) ? 0 : 1;
+}
+
+int rec_cli_run ( int argc, char **argv )
+{
+	if ( argc == 3 && g_str_equal ( argv[1], "--schedule" ) ) { gst_init ( NULL, NULL ); return rec_cli_schedule ( argv[2] ); }
+
+	if ( argc < 5 ) { rec_cli_usage ( argv[0] ); return 1; }
+
+	uint duration = (uint)atoi ( argv[3] );
+	uint8_t mode = ( argc > 5 ) ? dvb_rec_get_mode ( argv[5] ) : REC_REMUX;
+
+	if ( !duration || mode == REC_NUM || !g_strrstr ( argv[2], "delsys" ) ) { rec_cli_usage ( argv[0] ); return 1; }
+
+	gst_init ( NULL, NULL );
+
+	signal ( SIGINT,  rec_cli_signal );
+	signal ( SIGTERM, rec_cli_signal );
+
+	return rec_cli_record ( argv[2], duration, argv[4], mode );
+}
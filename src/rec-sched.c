@@ -0,0 +1,453 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "rec-sched.h"
+#include "include.h"
+#include "dvb-rec.h"
+#include "dvb-pool.h"
+#include "dvb-tune.h"
+#include "ts-file.h"
+
+#include <stdlib.h>
+#include <gst/gst.h>
+
+#define REC_SCHED_PRETUNE 5
+
+enum TimerState
+{
+	TIMER_WAIT,
+	TIMER_TUNED,
+	TIMER_REC,
+	TIMER_DONE
+};
+
+typedef struct _RecTuner RecTuner;
+
+struct _RecTuner
+{
+	char *tp_key;
+
+	GstElement *pipeline;
+	GstElement *tee;
+
+	DvbTuner *dvb_tuner;
+
+	uint bus_id;
+	uint users;
+};
+
+typedef struct _RecTimer RecTimer;
+
+struct _RecTimer
+{
+	char *data;
+	char *path;
+
+	gint64 start;
+	gint64 stop;
+
+	uint8_t mode;
+	uint8_t state;
+
+	RecTuner *tuner;
+	RecSched *sched;
+
+	GstElement *recbin;
+	GstElement *recmux;
+	GstElement *recsink;
+
+	GstPad *pad_tee;
+};
+
+struct _RecSched
+{
+	GSequence *queue;
+	GHashTable *tuners;
+
+	GDestroyNotify done;
+	gpointer data;
+
+	uint src_tm;
+	uint active;
+};
+
+static void rec_sched_arm ( RecSched * );
+
+static gint64 rec_sched_timer_time ( const RecTimer *timer )
+{
+	if ( timer->state == TIMER_WAIT  ) return timer->start - REC_SCHED_PRETUNE;
+	if ( timer->state == TIMER_TUNED ) return timer->start;
+
+	return timer->stop;
+}
+
+static int rec_sched_timer_cmp ( gconstpointer a, gconstpointer b, G_GNUC_UNUSED gpointer data )
+{
+	gint64 time_a = rec_sched_timer_time ( a );
+	gint64 time_b = rec_sched_timer_time ( b );
+
+	return ( time_a < time_b ) ? -1 : ( time_a > time_b );
+}
+
+static void rec_sched_timer_free ( RecTimer *timer )
+{
+	free ( timer->data );
+	free ( timer->path );
+
+	free ( timer );
+}
+
+static gboolean rec_sched_bus ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, RecTuner *tuner )
+{
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ELEMENT ) dvb_rec_index_section ( msg );
+
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ERROR )
+	{
+		GError *err = NULL;
+		char *dbg = NULL;
+
+		gst_message_parse_error ( msg, &err, &dbg );
+
+		g_warning ( "%s:: %s: %s ", __func__, tuner->tp_key, err->message );
+
+		g_error_free ( err );
+		free ( dbg );
+	}
+
+	return TRUE;
+}
+
+static RecTuner * rec_sched_tuner_get ( const char *data, RecSched *sched )
+{
+	g_autofree char *tp_key = dvb_get_tp_key ( data );
+
+	RecTuner *tuner = g_hash_table_lookup ( sched->tuners, tp_key );
+
+	if ( tuner ) { tuner->users++; return tuner; }
+
+	GstElement *pipeline = gst_pipeline_new ( NULL );
+	GstElement *dvbsrc   = ts_file_make_src ();
+	GstElement *tee      = gst_element_factory_make ( "tee",    NULL );
+
+	if ( !pipeline || !dvbsrc || !tee )
+	{
+		g_critical ( "%s:: dvbsrc ... - not created.", __func__ );
+
+		if ( pipeline ) gst_object_unref ( pipeline );
+		if ( dvbsrc   ) gst_object_unref ( dvbsrc   );
+		if ( tee      ) gst_object_unref ( tee      );
+
+		return NULL;
+	}
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), dvbsrc, tee, NULL );
+	gst_element_link ( dvbsrc, tee );
+
+	g_object_set ( tee, "allow-not-linked", TRUE, NULL );
+
+	dvb_data_set ( data, dvbsrc, NULL );
+
+	DvbTuner *dvb_tuner = dvb_pool_acquire ( data );
+
+	if ( dvb_tuner ) dvb_pool_set_dvbsrc ( dvb_tuner, dvbsrc ); else g_warning ( "%s:: no free tuner in the pool. ", __func__ );
+
+	tuner = g_new0 ( RecTuner, 1 );
+
+	tuner->dvb_tuner = dvb_tuner;
+
+	tuner->tp_key   = g_strdup ( tp_key );
+	tuner->pipeline = pipeline;
+	tuner->tee      = tee;
+	tuner->users    = 1;
+
+	GstBus *bus = gst_element_get_bus ( pipeline );
+	tuner->bus_id = gst_bus_add_watch ( bus, (GstBusFunc)rec_sched_bus, tuner );
+	gst_object_unref ( bus );
+
+	g_hash_table_insert ( sched->tuners, tuner->tp_key, tuner );
+
+	gst_element_set_state ( pipeline, GST_STATE_PLAYING );
+
+	g_debug ( "%s:: tuned %s ", __func__, tp_key );
+
+	return tuner;
+}
+
+static void rec_sched_tuner_release ( RecTuner *tuner, RecSched *sched )
+{
+	if ( --tuner->users ) return;
+
+	g_debug ( "%s:: release %s ", __func__, tuner->tp_key );
+
+	g_source_remove ( tuner->bus_id );
+
+	gst_element_set_state ( tuner->pipeline, GST_STATE_NULL );
+	gst_object_unref ( tuner->pipeline );
+
+	if ( tuner->dvb_tuner ) dvb_pool_release ( tuner->dvb_tuner );
+
+	g_hash_table_remove ( sched->tuners, tuner->tp_key );
+
+	free ( tuner->tp_key );
+	free ( tuner );
+}
+
+static void rec_sched_check_done ( RecSched *sched )
+{
+	if ( g_sequence_is_empty ( sched->queue ) && !sched->active && sched->done ) sched->done ( sched->data );
+}
+
+static void rec_sched_rec_done ( RecTimer *timer )
+{
+	RecSched *sched = timer->sched;
+
+	rec_sched_tuner_release ( timer->tuner, sched );
+	rec_sched_timer_free ( timer );
+
+	sched->active--;
+
+	rec_sched_check_done ( sched );
+}
+
+static void rec_sched_timer_step ( RecTimer *timer, RecSched *sched )
+{
+	if ( timer->state == TIMER_WAIT )
+	{
+		timer->tuner = rec_sched_tuner_get ( timer->data, sched );
+		timer->state = ( timer->tuner ) ? TIMER_TUNED : TIMER_DONE;
+
+		return;
+	}
+
+	if ( timer->state == TIMER_TUNED )
+	{
+		timer->recbin = dvb_rec_create_bin ( timer->path, timer->mode, dvb_get_sid ( timer->data ), timer->tuner->tp_key, &timer->recmux, &timer->recsink );
+
+		/* Held across the attach: on failure the bin is taken out of the pipeline again */
+		if ( timer->recbin ) gst_object_ref_sink ( timer->recbin );
+
+		if ( timer->recbin ) timer->pad_tee = dvb_rec_attach ( timer->tuner->tee, timer->recbin );
+
+		if ( timer->recbin ) gst_object_unref ( timer->recbin );
+
+		if ( !timer->pad_tee )
+		{
+			g_warning ( "%s:: %s: record not started. ", __func__, timer->path );
+
+			timer->recbin  = NULL;
+			timer->recmux  = NULL;
+			timer->recsink = NULL;
+
+			rec_sched_tuner_release ( timer->tuner, sched );
+			timer->state = TIMER_DONE;
+
+			return;
+		}
+
+		g_debug ( "%s:: start %s ", __func__, timer->path );
+
+		sched->active++;
+		timer->state = TIMER_REC;
+
+		return;
+	}
+
+	g_debug ( "%s:: stop %s ", __func__, timer->path );
+
+	timer->state = TIMER_DONE;
+
+	dvb_rec_detach ( timer->tuner->tee, timer->recbin, timer->recmux, timer->recsink, timer->pad_tee, (GDestroyNotify)rec_sched_rec_done, timer );
+}
+
+static gboolean rec_sched_run ( RecSched *sched )
+{
+	sched->src_tm = 0;
+
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+
+	while ( !g_sequence_is_empty ( sched->queue ) )
+	{
+		GSequenceIter *iter = g_sequence_get_begin_iter ( sched->queue );
+		RecTimer *timer = g_sequence_get ( iter );
+
+		if ( rec_sched_timer_time ( timer ) > now ) break;
+
+		g_sequence_remove ( iter );
+
+		uint8_t state = timer->state;
+
+		rec_sched_timer_step ( timer, sched );
+
+		if ( timer->state != TIMER_DONE )
+			g_sequence_insert_sorted ( sched->queue, timer, rec_sched_timer_cmp, NULL );
+		else if ( state != TIMER_REC )
+			rec_sched_timer_free ( timer );
+	}
+
+	rec_sched_arm ( sched );
+
+	return FALSE;
+}
+
+static void rec_sched_arm ( RecSched *sched )
+{
+	if ( sched->src_tm ) g_source_remove ( sched->src_tm );
+
+	sched->src_tm = 0;
+
+	if ( g_sequence_is_empty ( sched->queue ) ) { rec_sched_check_done ( sched ); return; }
+
+	RecTimer *timer = g_sequence_get ( g_sequence_get_begin_iter ( sched->queue ) );
+
+	gint64 delay = rec_sched_timer_time ( timer ) - g_get_real_time () / G_USEC_PER_SEC;
+
+	if ( delay <= 0 ) { sched->src_tm = g_timeout_add ( 0, (GSourceFunc)rec_sched_run, sched ); return; }
+
+	/* A wake-up before the timer is due just re-arms: this also corrects clock drift */
+	sched->src_tm = g_timeout_add_seconds ( (uint)MIN ( delay, G_MAXUINT ), (GSourceFunc)rec_sched_run, sched );
+}
+
+gboolean rec_sched_add ( RecSched *sched, const char *data, gint64 start, gint64 stop, const char *path, uint8_t mode )
+{
+	if ( stop <= start || mode >= REC_NUM || stop <= g_get_real_time () / G_USEC_PER_SEC ) return FALSE;
+
+	RecTimer *timer = g_new0 ( RecTimer, 1 );
+
+	timer->data  = g_strdup ( data );
+	timer->path  = g_strdup ( path );
+	timer->start = start;
+	timer->stop  = stop;
+	timer->mode  = mode;
+	timer->state = TIMER_WAIT;
+	timer->sched = sched;
+
+	g_sequence_insert_sorted ( sched->queue, timer, rec_sched_timer_cmp, NULL );
+
+	rec_sched_arm ( sched );
+
+	return TRUE;
+}
+
+static gint64 rec_sched_get_time ( GKeyFile *key_file, const char *group, const char *key )
+{
+	g_autofree char *str = g_key_file_get_string ( key_file, group, key, NULL );
+
+	if ( !str ) return 0;
+
+	GTimeZone *tz = g_time_zone_new_local ();
+	GDateTime *date = g_date_time_new_from_iso8601 ( str, tz );
+
+	gint64 ret = ( date ) ? g_date_time_to_unix ( date ) : 0;
+
+	if ( date ) g_date_time_unref ( date );
+	g_time_zone_unref ( tz );
+
+	return ret;
+}
+
+uint rec_sched_load ( RecSched *sched, const char *file )
+{
+	GError *err = NULL;
+	GKeyFile *key_file = g_key_file_new ();
+
+	if ( !g_key_file_load_from_file ( key_file, file, G_KEY_FILE_NONE, &err ) )
+	{
+		g_warning ( "%s:: %s ", __func__, err->message );
+
+		g_error_free ( err );
+		g_key_file_unref ( key_file );
+
+		return 0;
+	}
+
+	uint num = 0;
+	char **groups = g_key_file_get_groups ( key_file, NULL );
+
+	uint j = 0; for ( j = 0; groups[j]; j++ )
+	{
+		g_autofree char *data = g_key_file_get_string ( key_file, groups[j], "channel", NULL );
+		g_autofree char *path = g_key_file_get_string ( key_file, groups[j], "file",    NULL );
+		g_autofree char *mode = g_key_file_get_string ( key_file, groups[j], "mode",    NULL );
+
+		gint64 start = rec_sched_get_time ( key_file, groups[j], "start" );
+		gint64 stop  = rec_sched_get_time ( key_file, groups[j], "stop"  );
+
+		if ( data && path && rec_sched_add ( sched, data, start, stop, path, ( mode ) ? dvb_rec_get_mode ( mode ) : REC_REMUX ) )
+			num++;
+		else
+			g_warning ( "%s:: [%s] skipped. ", __func__, groups[j] );
+	}
+
+	g_strfreev ( groups );
+	g_key_file_unref ( key_file );
+
+	return num;
+}
+
+void rec_sched_cancel ( RecSched *sched )
+{
+	GSequenceIter *iter = g_sequence_get_begin_iter ( sched->queue );
+
+	while ( !g_sequence_iter_is_end ( iter ) )
+	{
+		RecTimer *timer = g_sequence_get ( iter );
+
+		GSequenceIter *next = g_sequence_iter_next ( iter );
+
+		if ( timer->state == TIMER_REC )
+		{
+			timer->stop = 0;
+		}
+		else
+		{
+			if ( timer->state == TIMER_TUNED ) rec_sched_tuner_release ( timer->tuner, sched );
+
+			g_sequence_remove ( iter );
+			rec_sched_timer_free ( timer );
+		}
+
+		iter = next;
+	}
+
+	g_sequence_sort ( sched->queue, rec_sched_timer_cmp, NULL );
+
+	rec_sched_arm ( sched );
+}
+
+void rec_sched_free ( RecSched *sched )
+{
+	if ( sched->src_tm ) g_source_remove ( sched->src_tm );
+
+	while ( !g_sequence_is_empty ( sched->queue ) )
+	{
+		GSequenceIter *iter = g_sequence_get_begin_iter ( sched->queue );
+
+		rec_sched_timer_free ( g_sequence_get ( iter ) );
+
+		g_sequence_remove ( iter );
+	}
+
+	g_sequence_free ( sched->queue );
+	g_hash_table_unref ( sched->tuners );
+
+	free ( sched );
+}
+
+RecSched * rec_sched_new ( GDestroyNotify done, gpointer data )
+{
+	RecSched *sched = g_new0 ( RecSched, 1 );
+
+	sched->queue  = g_sequence_new ( NULL );
+	sched->tuners = g_hash_table_new ( g_str_hash, g_str_equal );
+
+	sched->done = done;
+	sched->data = data;
+
+	return sched;
+}
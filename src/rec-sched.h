@@ -0,0 +1,25 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+typedef struct _RecSched RecSched;
+
+RecSched * rec_sched_new ( GDestroyNotify, gpointer );
+
+gboolean rec_sched_add ( RecSched *, const char *, gint64, gint64, const char *, uint8_t );
+
+uint rec_sched_load ( RecSched *, const char * );
+
+void rec_sched_cancel ( RecSched * );
+
+void rec_sched_free ( RecSched * );
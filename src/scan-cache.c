@@ -0,0 +1,181 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "scan-cache.h"
+#include "dvb-tune.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <linux/dvb/frontend.h>
+
+struct _ScanCache
+{
+	GKeyFile *key_file;
+	char *path;
+
+	gboolean changed;
+};
+
+ScanCache * scan_cache_new ( void )
+{
+	ScanCache *cache = g_new0 ( ScanCache, 1 );
+
+	cache->key_file = g_key_file_new ();
+	cache->path = g_strdup_printf ( "%s/helia/scan-cache.conf", g_get_user_config_dir () );
+
+	GError *err = NULL;
+
+	if ( g_file_test ( cache->path, G_FILE_TEST_EXISTS ) && !g_key_file_load_from_file ( cache->key_file, cache->path, G_KEY_FILE_NONE, &err ) )
+	{
+		g_warning ( "%s:: %s ", __func__, err->message );
+		g_error_free ( err );
+	}
+
+	return cache;
+}
+
+/* Lists and NIT differ by small offsets: satellite kHz to 2 MHz, others Hz to 1 MHz */
+char * scan_cache_key ( const char *data )
+{
+	long adapter  = dvb_get_field ( data, "adapter",  0 );
+	long frontend = dvb_get_field ( data, "frontend", 0 );
+	long delsys   = dvb_get_field ( data, "delsys", SYS_UNDEFINED );
+	long freq     = dvb_get_field ( data, "frequency", 0 );
+
+	const DvbChanProp *pol = dvb_chan_find ( dvb_chan_get ( data ), "polarity" );
+
+	gboolean sat = ( delsys == SYS_DVBS || delsys == SYS_DVBS2 || delsys == SYS_TURBO );
+
+	long step = ( sat ) ? 2000 : 1000000;
+
+	char v = ( pol && ( pol->value[0] == 'v' || pol->value[0] == 'V' || pol->value[0] == '0' ) ) ? 'V' : 'H';
+
+	return g_strdup_printf ( "%ld.%ld:%d:%ld:%c", adapter, frontend, sat, ( freq + step / 2 ) / step, ( sat ) ? v : '-' );
+}
+
+static gboolean scan_cache_version ( ScanCache *cache, const char *group, const char *key, int version )
+{
+	if ( !g_key_file_has_key ( cache->key_file, group, key, NULL ) ) return FALSE;
+
+	return ( g_key_file_get_integer ( cache->key_file, group, key, NULL ) == version );
+}
+
+/* TRUE if PAT, SDT and every PMT still have the cached versions; the lists are owned by the caller */
+gboolean scan_cache_lookup ( ScanCache *cache, const char *data, ScanTables *tables, char ***services, char ***tps )
+{
+	g_autofree char *group = scan_cache_key ( data );
+
+	if ( !g_key_file_has_group ( cache->key_file, group ) ) return FALSE;
+
+	if ( !scan_cache_version ( cache, group, "pat-version", scan_tables_get_version ( tables, SCAN_TABLE_PAT ) ) ) return FALSE;
+	if ( !scan_cache_version ( cache, group, "sdt-version", scan_tables_get_version ( tables, SCAN_TABLE_SDT ) ) ) return FALSE;
+
+	g_autofree char *pmt = scan_tables_get_pmt_versions ( tables );
+	g_autofree char *pmt_cache = g_key_file_get_string ( cache->key_file, group, "pmt-versions", NULL );
+
+	if ( !pmt || !pmt_cache || !g_str_equal ( pmt, pmt_cache ) ) return FALSE;
+
+	*services = g_key_file_get_string_list ( cache->key_file, group, "services", NULL, NULL );
+
+	if ( *services == NULL ) return FALSE;
+
+	*tps = g_key_file_get_string_list ( cache->key_file, group, "tps", NULL, NULL );
+
+	return TRUE;
+}
+
+void scan_cache_store ( ScanCache *cache, const char *data, ScanTables *tables, GPtrArray *services )
+{
+	if ( !services->len ) return;
+
+	g_autofree char *group = scan_cache_key ( data );
+
+	GKeyFile *key_file = cache->key_file;
+
+	g_key_file_remove_group ( key_file, group, NULL );
+
+	g_key_file_set_string  ( key_file, group, "data", data );
+	g_key_file_set_int64   ( key_file, group, "time", g_get_real_time () / G_USEC_PER_SEC );
+	g_key_file_set_integer ( key_file, group, "pat-version", scan_tables_get_version ( tables, SCAN_TABLE_PAT ) );
+	g_key_file_set_integer ( key_file, group, "sdt-version", scan_tables_get_version ( tables, SCAN_TABLE_SDT ) );
+
+	g_autofree char *pmt = scan_tables_get_pmt_versions ( tables );
+
+	if ( pmt ) g_key_file_set_string ( key_file, group, "pmt-versions", pmt );
+
+	int nit = scan_tables_get_version ( tables, SCAN_TABLE_NIT );
+
+	if ( nit >= 0 ) g_key_file_set_integer ( key_file, group, "nit-version", nit );
+
+	g_key_file_set_string_list ( key_file, group, "services", (const char * const *)services->pdata, services->len );
+
+	GPtrArray *tps = scan_tables_get_tps ( tables );
+
+	if ( tps->len ) g_key_file_set_string_list ( key_file, group, "tps", (const char * const *)tps->pdata, tps->len );
+
+	cache->changed = TRUE;
+}
+
+uint scan_cache_foreach ( ScanCache *cache, ScanFound found, gpointer data )
+{
+	uint i = 0, j = 0, count = 0;
+
+	char **groups = g_key_file_get_groups ( cache->key_file, NULL );
+
+	for ( j = 0; groups[j]; j++ )
+	{
+		char **services = g_key_file_get_string_list ( cache->key_file, groups[j], "services", NULL, NULL );
+
+		for ( i = 0; services && services[i]; i++ )
+		{
+			const char *sep = strchr ( services[i], ':' );
+
+			if ( !sep ) continue;
+
+			g_autofree char *name = g_strndup ( services[i], (gsize)( sep - services[i] ) );
+
+			found ( name, services[i], data );
+
+			count++;
+		}
+
+		g_strfreev ( services );
+	}
+
+	g_strfreev ( groups );
+
+	return count;
+}
+
+void scan_cache_save ( ScanCache *cache )
+{
+	if ( !cache->changed ) return;
+
+	GError *err = NULL;
+
+	if ( !g_key_file_save_to_file ( cache->key_file, cache->path, &err ) )
+	{
+		g_warning ( "%s:: %s ", __func__, err->message );
+		g_error_free ( err );
+
+		return;
+	}
+
+	cache->changed = FALSE;
+}
+
+void scan_cache_free ( ScanCache *cache )
+{
+	scan_cache_save ( cache );
+
+	g_key_file_unref ( cache->key_file );
+	free ( cache->path );
+
+	free ( cache );
+}
@@ -0,0 +1,28 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include "scan-tables.h"
+
+typedef struct _ScanCache ScanCache;
+
+ScanCache * scan_cache_new ( void );
+
+char * scan_cache_key ( const char * );
+
+gboolean scan_cache_lookup ( ScanCache *, const char *, ScanTables *, char ***, char *** );
+
+void scan_cache_store ( ScanCache *, const char *, ScanTables *, GPtrArray * );
+
+uint scan_cache_foreach ( ScanCache *, ScanFound, gpointer );
+
+void scan_cache_save ( ScanCache * );
+
+void scan_cache_free ( ScanCache * );
@@ -0,0 +1,531 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "scan-engine.h"
+#include "scan-cache.h"
+#include "convert.h"
+#include "dvb-pool.h"
+#include "dvb-tune.h"
+#include "ts-file.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <linux/dvb/frontend.h>
+
+/* Tuning timeouts in ms: a short carrier probe, a full lock only on a carrier */
+#define SCAN_PROBE_MS     500
+#define SCAN_PROBE_SAT_MS 1500
+#define SCAN_LOCK_MS      5000
+
+/* Seconds to wait for the service tables once locked; NIT repeats up to every 10 s */
+#define SCAN_SECTION_TIMEOUT 12
+
+/* Seconds to wait for a NIT not seen yet once PAT, SDT and PMT are complete */
+#define SCAN_NIT_WAIT 3
+
+typedef struct _ScanJob ScanJob;
+
+struct _ScanJob
+{
+	char *data;
+
+	GstElement *pipeline;
+	GstElement *dvbsrc;
+
+	DvbTuner *tuner;
+	ScanEngine *engine;
+	ScanTables *tables;
+	GPtrArray *services;
+
+	uint tune_ms;
+	gboolean carrier;
+	gboolean lock;
+	gboolean nit_wait;
+	gboolean cache_tried;
+
+	uint bus_id;
+	uint src_tm;
+};
+
+struct _ScanEngine
+{
+	GQueue *queue;
+	GPtrArray *jobs;
+	GHashTable *seen;
+	GHashTable *tps;
+	ScanCache *cache;
+
+	ScanFound found;
+	GDestroyNotify done;
+	gpointer data;
+
+	gboolean run;
+	gboolean no_tuner;
+};
+
+static void scan_engine_next ( ScanEngine * );
+
+static void scan_job_set_timeout ( ScanJob *, uint );
+
+static void scan_engine_found ( const char *name, const char *data, ScanEngine *engine )
+{
+	if ( g_hash_table_contains ( engine->seen, data ) ) return;
+
+	g_hash_table_add ( engine->seen, g_strdup ( data ) );
+
+	engine->found ( name, data, engine->data );
+}
+
+static const char *scan_carry_n[] = { "adapter", "frontend", "lnb-type", "lnb-lof1", "lnb-lof2", "lnb-slof", "diseqc-source" };
+
+static gboolean scan_engine_tp_new ( ScanEngine *engine, const char *data )
+{
+	char *key = scan_cache_key ( data );
+
+	if ( g_hash_table_contains ( engine->tps, key ) ) { free ( key ); return FALSE; }
+
+	g_hash_table_add ( engine->tps, key );
+
+	return TRUE;
+}
+
+static void scan_job_queue_tp ( ScanJob *job, const char *tp )
+{
+	const DvbChan *chan = dvb_chan_get ( job->data );
+
+	GString *gstring = g_string_new ( "NIT" );
+
+	uint c = 0; for ( c = 0; c < G_N_ELEMENTS ( scan_carry_n ); c++ )
+	{
+		const DvbChanProp *prop = dvb_chan_find ( chan, scan_carry_n[c] );
+
+		if ( prop ) g_string_append_printf ( gstring, ":%s=%s", prop->key, prop->value );
+	}
+
+	g_string_append ( gstring, tp );
+
+	if ( scan_engine_tp_new ( job->engine, gstring->str ) )
+	{
+		g_debug ( "%s:: %s ", __func__, gstring->str );
+
+		g_queue_push_tail ( job->engine->queue, g_strdup ( gstring->str ) );
+	}
+
+	g_string_free ( gstring, TRUE );
+}
+
+static void scan_job_found ( const char *name, const char *data, ScanJob *job )
+{
+	g_ptr_array_add ( job->services, g_strdup ( data ) );
+
+	scan_engine_found ( name, data, job->engine );
+}
+
+static void scan_job_emit ( ScanJob *job )
+{
+	scan_tables_emit ( job->tables, job->dvbsrc, (ScanFound)scan_job_found, job );
+
+	GPtrArray *tps = scan_tables_get_tps ( job->tables );
+
+	uint i = 0; for ( i = 0; i < tps->len; i++ ) scan_job_queue_tp ( job, g_ptr_array_index ( tps, i ) );
+
+	if ( scan_tables_complete ( job->tables, FALSE ) ) scan_cache_store ( job->engine->cache, job->data, job->tables, job->services );
+}
+
+/* Once PAT, SDT and all PMT versions are known, an unchanged transponder is taken from the cache */
+static gboolean scan_job_cached ( ScanJob *job )
+{
+	if ( job->cache_tried ) return FALSE;
+
+	if ( scan_tables_get_version ( job->tables, SCAN_TABLE_PAT ) < 0 || scan_tables_get_version ( job->tables, SCAN_TABLE_SDT ) < 0 ) return FALSE;
+
+	g_autofree char *pmt = scan_tables_get_pmt_versions ( job->tables );
+
+	if ( !pmt ) return FALSE;
+
+	job->cache_tried = TRUE;
+
+	char **services = NULL, **tps = NULL;
+
+	if ( !scan_cache_lookup ( job->engine->cache, job->data, job->tables, &services, &tps ) ) return FALSE;
+
+	uint i = 0; for ( i = 0; services[i]; i++ )
+	{
+		const char *sep = strchr ( services[i], ':' );
+
+		g_autofree char *name = ( sep ) ? g_strndup ( services[i], (gsize)( sep - services[i] ) ) : g_strdup ( services[i] );
+
+		scan_engine_found ( name, services[i], job->engine );
+	}
+
+	g_message ( "Services: %u ( unchanged ) \n", i );
+
+	for ( i = 0; tps && tps[i]; i++ ) scan_job_queue_tp ( job, tps[i] );
+
+	g_debug ( "%s:: unchanged: %s ", __func__, job->data );
+
+	g_strfreev ( services );
+	g_strfreev ( tps );
+
+	return TRUE;
+}
+
+static gboolean scan_job_sections ( ScanJob *job )
+{
+	if ( scan_tables_complete ( job->tables, TRUE ) ) { scan_job_emit ( job ); return TRUE; }
+
+	/* A mux without NIT actual: emit after a short window, not the full section timeout */
+	if ( !job->nit_wait && scan_tables_get_version ( job->tables, SCAN_TABLE_NIT ) < 0 && scan_tables_complete ( job->tables, FALSE ) )
+	{
+		job->nit_wait = TRUE;
+
+		scan_job_set_timeout ( job, SCAN_NIT_WAIT * 1000 );
+	}
+
+	return scan_job_cached ( job );
+}
+
+static void scan_job_clear ( ScanJob *job )
+{
+	if ( job->bus_id ) g_source_remove ( job->bus_id );
+	if ( job->src_tm ) g_source_remove ( job->src_tm );
+
+	job->bus_id = 0;
+	job->src_tm = 0;
+
+	if ( !job->pipeline ) return;
+
+	dvb_pool_stop ( job->pipeline );
+	gst_object_unref ( job->pipeline );
+
+	job->pipeline = NULL;
+	job->dvbsrc   = NULL;
+
+	if ( job->tables ) scan_tables_free ( job->tables );
+	job->tables = NULL;
+
+	if ( job->services ) g_ptr_array_unref ( job->services );
+	job->services = NULL;
+}
+
+static void scan_job_finish ( ScanJob *job )
+{
+	ScanEngine *engine = job->engine;
+
+	scan_job_clear ( job );
+
+	dvb_pool_release ( job->tuner );
+
+	g_debug ( "%s:: %s ", __func__, job->data );
+
+	g_ptr_array_remove_fast ( engine->jobs, job );
+
+	free ( job->data );
+	free ( job );
+
+	scan_engine_next ( engine );
+}
+
+static gboolean scan_job_timeout ( ScanJob *job )
+{
+	job->src_tm = 0;
+
+	g_debug ( "%s:: %s: %s ", __func__, ( job->nit_wait ) ? "no NIT" : ( job->lock ) ? "tables incomplete" : "no lock", job->data );
+
+	if ( job->lock || job->nit_wait ) scan_job_emit ( job );
+
+	scan_job_finish ( job );
+
+	return G_SOURCE_REMOVE;
+}
+
+static void scan_job_set_timeout ( ScanJob *job, uint ms )
+{
+	if ( job->src_tm ) g_source_remove ( job->src_tm );
+
+	job->src_tm = g_timeout_add ( ms, (GSourceFunc)scan_job_timeout, job );
+}
+
+static gboolean scan_job_bus ( GstBus *, GstMessage *, ScanJob * );
+
+static gboolean scan_job_tune ( ScanJob *job, uint tune_ms )
+{
+	GstElement *pipeline = gst_pipeline_new ( NULL );
+	GstElement *dvbsrc   = ts_file_make_src ();
+	GstElement *tsparse  = gst_element_factory_make ( "tsparse",  NULL );
+	GstElement *fakesink = gst_element_factory_make ( "fakesink", NULL );
+
+	if ( !pipeline || !dvbsrc || !tsparse || !fakesink ) { g_critical ( "%s:: pipeline scan - not be created.", __func__ ); return FALSE; }
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), dvbsrc, tsparse, fakesink, NULL );
+	gst_element_link_many ( dvbsrc, tsparse, fakesink, NULL );
+
+	dvb_data_set ( job->data, dvbsrc, NULL );
+
+	dvb_pool_set_dvbsrc ( job->tuner, dvbsrc );
+
+	g_object_set ( dvbsrc, "tuning-timeout", (guint64)tune_ms * GST_MSECOND, NULL );
+
+	job->pipeline = pipeline;
+	job->dvbsrc   = dvbsrc;
+	job->tune_ms  = tune_ms;
+	job->carrier  = FALSE;
+	job->lock     = FALSE;
+	job->nit_wait = FALSE;
+	job->tables   = scan_tables_new ();
+	job->services = g_ptr_array_new_with_free_func ( free );
+	job->cache_tried = FALSE;
+
+	GstBus *bus = gst_element_get_bus ( pipeline );
+	job->bus_id = gst_bus_add_watch ( bus, (GstBusFunc)scan_job_bus, job );
+	gst_object_unref ( bus );
+
+	/* Guard only: a failed tune posts an error after tune_ms */
+	scan_job_set_timeout ( job, tune_ms + SCAN_SECTION_TIMEOUT * 1000 );
+
+	dvb_pool_play ( pipeline );
+
+	return TRUE;
+}
+
+static void scan_job_stats ( const GstStructure *structure, ScanJob *job )
+{
+	int status = 0;
+	gboolean lock = FALSE;
+
+	gst_structure_get_int ( structure, "status", &status );
+	gst_structure_get_boolean ( structure, "lock", &lock );
+
+	if ( status & FE_HAS_CARRIER ) job->carrier = TRUE;
+
+	if ( !lock || job->lock ) return;
+
+	job->lock = TRUE;
+
+	/* Locked: from now on only the tables are waited for */
+	scan_job_set_timeout ( job, SCAN_SECTION_TIMEOUT * 1000 );
+}
+
+static gboolean scan_job_bus ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, ScanJob *job )
+{
+	gboolean done = FALSE;
+
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ERROR )
+	{
+		GError *err = NULL;
+		char *dbg = NULL;
+
+		gst_message_parse_error ( msg, &err, &dbg );
+
+		g_debug ( "%s:: %s: %s ", __func__, job->data, err->message );
+
+		g_error_free ( err );
+		free ( dbg );
+
+		/* A carrier without lock in the probe gets one full-length tune */
+		if ( job->carrier && !job->lock && job->tune_ms < SCAN_LOCK_MS )
+		{
+			job->bus_id = 0;
+
+			scan_job_clear ( job );
+
+			if ( !scan_job_tune ( job, SCAN_LOCK_MS ) ) scan_job_finish ( job );
+
+			return G_SOURCE_REMOVE;
+		}
+
+		done = TRUE;
+	}
+
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ELEMENT )
+	{
+		const GstStructure *structure = gst_message_get_structure ( msg );
+
+		if ( structure && gst_structure_has_name ( structure, "dvb-frontend-stats" ) )
+			scan_job_stats ( structure, job );
+		else if ( scan_tables_parse ( job->tables, msg ) )
+			done = scan_job_sections ( job );
+	}
+
+	if ( !done ) return G_SOURCE_CONTINUE;
+
+	job->bus_id = 0;
+
+	scan_job_finish ( job );
+
+	return G_SOURCE_REMOVE;
+}
+
+static ScanJob * scan_job_new ( const char *data, DvbTuner *tuner, ScanEngine *engine )
+{
+	ScanJob *job = g_new0 ( ScanJob, 1 );
+
+	job->data   = g_strdup ( data );
+	job->tuner  = tuner;
+	job->engine = engine;
+
+	long delsys = dvb_get_field ( data, "delsys", SYS_UNDEFINED );
+
+	uint probe = ( delsys == SYS_DVBS || delsys == SYS_DVBS2 || delsys == SYS_TURBO ) ? SCAN_PROBE_SAT_MS : SCAN_PROBE_MS;
+
+	if ( scan_job_tune ( job, probe ) ) return job;
+
+	free ( job->data );
+	free ( job );
+
+	return NULL;
+}
+
+static void scan_engine_next ( ScanEngine *engine )
+{
+	while ( engine->run && !g_queue_is_empty ( engine->queue ) )
+	{
+		const char *data = g_queue_peek_head ( engine->queue );
+
+		DvbTuner *tuner = dvb_pool_acquire ( data );
+
+		if ( !tuner && engine->jobs->len ) break;
+
+		/* Nothing running to free a tuner: stop instead of draining the queue */
+		if ( !tuner )
+		{
+			g_warning ( "%s:: no free tuner for %s ", __func__, data );
+
+			engine->no_tuner = TRUE;
+
+			g_queue_clear_full ( engine->queue, free );
+			g_hash_table_remove_all ( engine->tps );
+
+			break;
+		}
+
+		g_autofree char *tp = g_queue_pop_head ( engine->queue );
+
+		ScanJob *job = scan_job_new ( tp, tuner, engine );
+
+		if ( job ) g_ptr_array_add ( engine->jobs, job ); else dvb_pool_release ( tuner );
+	}
+
+	if ( !engine->run || engine->jobs->len || !g_queue_is_empty ( engine->queue ) ) return;
+
+	engine->run = FALSE;
+
+	scan_cache_save ( engine->cache );
+
+	if ( engine->done ) engine->done ( engine->data );
+}
+
+ScanEngine * scan_engine_new ( ScanFound found, GDestroyNotify done, gpointer data )
+{
+	scan_tables_mpegts_init ();
+
+	ScanEngine *engine = g_new0 ( ScanEngine, 1 );
+
+	engine->queue = g_queue_new ();
+	engine->jobs  = g_ptr_array_new ();
+	engine->seen  = g_hash_table_new_full ( g_str_hash, g_str_equal, free, NULL );
+	engine->tps   = g_hash_table_new_full ( g_str_hash, g_str_equal, free, NULL );
+	engine->cache = scan_cache_new ();
+
+	engine->found = found;
+	engine->done  = done;
+	engine->data  = data;
+
+	return engine;
+}
+
+void scan_engine_add ( ScanEngine *engine, const char *data )
+{
+	if ( scan_engine_tp_new ( engine, data ) ) g_queue_push_tail ( engine->queue, g_strdup ( data ) );
+}
+
+uint scan_engine_load ( ScanEngine *engine, const char *file, uint adapter, uint frontend )
+{
+	char *contents = NULL;
+	GError *err = NULL;
+
+	if ( !g_file_get_contents ( file, &contents, NULL, &err ) )
+	{
+		g_warning ( "%s:: %s ", __func__, err->message );
+		g_error_free ( err );
+
+		return 0;
+	}
+
+	Convert *convert = convert_new ();
+
+	char **lines = g_strsplit ( contents, "[", 0 );
+	uint n = 0, count = 0, length = g_strv_length ( lines );
+
+	for ( n = 1; n < length; n++ )
+	{
+		GString *gstr_name = g_string_new ( NULL );
+		GString *gstr_data = g_string_new ( NULL );
+
+		g_signal_emit_by_name ( convert, "convert", adapter, frontend, lines[n], gstr_name, gstr_data );
+
+		if ( g_strrstr ( gstr_data->str, "frequency=" ) ) { scan_engine_add ( engine, gstr_data->str ); count++; }
+
+		g_string_free ( gstr_name, TRUE );
+		g_string_free ( gstr_data, TRUE );
+	}
+
+	g_strfreev ( lines );
+	free ( contents );
+
+	g_object_unref ( convert );
+
+	return count;
+}
+
+void scan_engine_start ( ScanEngine *engine )
+{
+	if ( engine->run ) return;
+
+	engine->run = TRUE;
+	engine->no_tuner = FALSE;
+
+	scan_engine_next ( engine );
+}
+
+uint scan_engine_get_left ( ScanEngine *engine )
+{
+	return g_queue_get_length ( engine->queue ) + engine->jobs->len;
+}
+
+/* TRUE if the last run ended because no tuner was free */
+gboolean scan_engine_get_no_tuner ( ScanEngine *engine )
+{
+	return engine->no_tuner;
+}
+
+void scan_engine_stop ( ScanEngine *engine )
+{
+	engine->run = FALSE;
+
+	while ( engine->jobs->len ) scan_job_finish ( g_ptr_array_index ( engine->jobs, 0 ) );
+
+	g_queue_clear_full ( engine->queue, free );
+
+	g_hash_table_remove_all ( engine->tps );
+}
+
+void scan_engine_free ( ScanEngine *engine )
+{
+	scan_engine_stop ( engine );
+
+	g_queue_free ( engine->queue );
+	g_ptr_array_free ( engine->jobs, TRUE );
+	g_hash_table_unref ( engine->seen );
+	g_hash_table_unref ( engine->tps );
+
+	scan_cache_free ( engine->cache );
+
+	free ( engine );
+}
@@ -0,0 +1,30 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include "scan-tables.h"
+
+typedef struct _ScanEngine ScanEngine;
+
+ScanEngine * scan_engine_new ( ScanFound, GDestroyNotify, gpointer );
+
+void scan_engine_add ( ScanEngine *, const char * );
+
+uint scan_engine_load ( ScanEngine *, const char *, uint, uint );
+
+void scan_engine_start ( ScanEngine * );
+
+uint scan_engine_get_left ( ScanEngine * );
+
+gboolean scan_engine_get_no_tuner ( ScanEngine * );
+
+void scan_engine_stop ( ScanEngine * );
+
+void scan_engine_free ( ScanEngine * );
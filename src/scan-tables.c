@@ -0,0 +1,546 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "scan-tables.h"
+#include "descr.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <linux/dvb/frontend.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/mpegts/mpegts.h>
+
+typedef struct _ScanSecs ScanSecs;
+
+struct _ScanSecs
+{
+	gboolean init;
+
+	uint8_t version;
+	uint8_t last;
+
+	uint count;
+	uint8_t got[32];
+};
+
+typedef struct _ScanService ScanService;
+
+struct _ScanService
+{
+	uint16_t sid;
+	uint16_t pmt_pid;
+
+	uint16_t video_pid;
+	uint16_t audio_pid;
+
+	uint8_t type;
+	uint8_t pmt_version;
+
+	gboolean ca;
+	gboolean pat;
+	gboolean pmt;
+
+	char *name;
+	char *provider;
+};
+
+struct _ScanTables
+{
+	ScanSecs pat;
+	ScanSecs sdt;
+	ScanSecs nit;
+
+	gboolean vct;
+
+	GHashTable *services;
+	GPtrArray *tps;
+};
+
+void scan_tables_mpegts_init ( void )
+{
+	gst_mpegts_initialize ();
+
+	g_type_class_ref ( GST_TYPE_MPEGTS_SECTION_TYPE );
+	g_type_class_ref ( GST_TYPE_MPEGTS_SECTION_TABLE_ID );
+}
+
+static void _strip_ch_name ( char *name )
+{
+	uint i = 0; for ( i = 0; name[i] != '\0'; i++ )
+	{
+		if ( name[i] == ':' || name[i] == '/' || name[i] == '\'' ) name[i] = ' ';
+	}
+
+	g_strstrip ( name );
+}
+
+static void scan_service_free ( ScanService *service )
+{
+	free ( service->name );
+	free ( service->provider );
+
+	free ( service );
+}
+
+ScanTables * scan_tables_new ( void )
+{
+	ScanTables *tables = g_new0 ( ScanTables, 1 );
+
+	tables->services = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)scan_service_free );
+	tables->tps = g_ptr_array_new_with_free_func ( free );
+
+	return tables;
+}
+
+void scan_tables_free ( ScanTables *tables )
+{
+	g_hash_table_unref ( tables->services );
+	g_ptr_array_unref ( tables->tps );
+
+	free ( tables );
+}
+
+static ScanService * scan_tables_service ( ScanTables *tables, uint16_t sid )
+{
+	ScanService *service = g_hash_table_lookup ( tables->services, GUINT_TO_POINTER ( sid ) );
+
+	if ( service ) return service;
+
+	service = g_new0 ( ScanService, 1 );
+	service->sid = sid;
+
+	g_hash_table_insert ( tables->services, GUINT_TO_POINTER ( sid ), service );
+
+	return service;
+}
+
+/* Returns TRUE for a section not seen yet in the current version of the table */
+static gboolean scan_secs_add ( ScanSecs *secs, GstMpegtsSection *section )
+{
+	if ( !secs->init || secs->version != section->version_number )
+	{
+		memset ( secs, 0, sizeof ( ScanSecs ) );
+
+		secs->init    = TRUE;
+		secs->version = section->version_number;
+	}
+
+	secs->last = section->last_section_number;
+
+	uint8_t n = section->section_number;
+
+	if ( secs->got[n / 8] & ( 1u << ( n % 8 ) ) ) return FALSE;
+
+	secs->got[n / 8] |= (uint8_t)( 1u << ( n % 8 ) );
+	secs->count++;
+
+	return TRUE;
+}
+
+static gboolean scan_secs_done ( const ScanSecs *secs )
+{
+	return ( secs->init && secs->count == (uint)secs->last + 1 );
+}
+
+static void scan_tables_pat ( ScanTables *tables, GstMpegtsSection *section )
+{
+	GPtrArray *pat = gst_mpegts_section_get_pat ( section );
+
+	if ( !pat ) return;
+
+	uint i = 0; for ( i = 0; i < pat->len; i++ )
+	{
+		GstMpegtsPatProgram *program = g_ptr_array_index ( pat, i );
+
+		if ( program->program_number == 0 ) continue;
+
+		ScanService *service = scan_tables_service ( tables, program->program_number );
+
+		service->pat = TRUE;
+		service->pmt_pid = program->network_or_program_map_PID;
+	}
+
+	g_ptr_array_unref ( pat );
+}
+
+static gboolean scan_tables_has_ca ( GPtrArray *descriptors )
+{
+	uint i = 0; for ( i = 0; descriptors && i < descriptors->len; i++ )
+	{
+		GstMpegtsDescriptor *desc = g_ptr_array_index ( descriptors, i );
+
+		if ( desc->tag == GST_MTS_DESC_CA ) return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean scan_tables_is_audio ( const GstMpegtsPMTStream *stream )
+{
+	switch ( stream->stream_type )
+	{
+		case GST_MPEGTS_STREAM_TYPE_AUDIO_MPEG1:
+		case GST_MPEGTS_STREAM_TYPE_AUDIO_MPEG2:
+		case GST_MPEGTS_STREAM_TYPE_AUDIO_AAC_ADTS:
+		case GST_MPEGTS_STREAM_TYPE_AUDIO_AAC_LATM:
+		case 0x81: /* ATSC AC-3 */
+		case 0x87: /* ATSC E-AC-3 */
+			return TRUE;
+
+		case GST_MPEGTS_STREAM_TYPE_PRIVATE_PES_PACKETS:
+		{
+			uint i = 0; for ( i = 0; i < stream->descriptors->len; i++ )
+			{
+				GstMpegtsDescriptor *desc = g_ptr_array_index ( stream->descriptors, i );
+
+				if ( desc->tag == GST_MTS_DESC_DVB_AC3 || desc->tag == GST_MTS_DESC_DVB_ENHANCED_AC3 || desc->tag == GST_MTS_DESC_DVB_AAC ) return TRUE;
+			}
+
+			return FALSE;
+		}
+
+		default:
+			return FALSE;
+	}
+}
+
+static gboolean scan_tables_is_video ( const GstMpegtsPMTStream *stream )
+{
+	return ( stream->stream_type == GST_MPEGTS_STREAM_TYPE_VIDEO_MPEG1 || stream->stream_type == GST_MPEGTS_STREAM_TYPE_VIDEO_MPEG2
+		|| stream->stream_type == GST_MPEGTS_STREAM_TYPE_VIDEO_MPEG4 || stream->stream_type == GST_MPEGTS_STREAM_TYPE_VIDEO_H264
+		|| stream->stream_type == GST_MPEGTS_STREAM_TYPE_VIDEO_HEVC );
+}
+
+static void scan_tables_pmt ( ScanTables *tables, GstMpegtsSection *section )
+{
+	const GstMpegtsPMT *pmt = gst_mpegts_section_get_pmt ( section );
+
+	if ( !pmt ) return;
+
+	ScanService *service = scan_tables_service ( tables, pmt->program_number );
+
+	service->pmt = TRUE;
+	service->pmt_version = section->version_number;
+
+	if ( scan_tables_has_ca ( pmt->descriptors ) ) service->ca = TRUE;
+
+	uint i = 0; for ( i = 0; i < pmt->streams->len; i++ )
+	{
+		const GstMpegtsPMTStream *stream = g_ptr_array_index ( pmt->streams, i );
+
+		if ( scan_tables_has_ca ( stream->descriptors ) ) service->ca = TRUE;
+
+		if ( !service->video_pid && scan_tables_is_video ( stream ) ) service->video_pid = stream->pid;
+		if ( !service->audio_pid && scan_tables_is_audio ( stream ) ) service->audio_pid = stream->pid;
+	}
+}
+
+static void scan_tables_sdt ( ScanTables *tables, GstMpegtsSection *section )
+{
+	const GstMpegtsSDT *sdt = gst_mpegts_section_get_sdt ( section );
+
+	if ( !sdt ) return;
+
+	uint i = 0, c = 0;
+
+	for ( i = 0; i < sdt->services->len; i++ )
+	{
+		GstMpegtsSDTService *sdt_service = g_ptr_array_index ( sdt->services, i );
+
+		ScanService *service = scan_tables_service ( tables, sdt_service->service_id );
+
+		if ( sdt_service->free_CA_mode ) service->ca = TRUE;
+
+		for ( c = 0; c < sdt_service->descriptors->len; c++ )
+		{
+			GstMpegtsDescriptor *desc = g_ptr_array_index ( sdt_service->descriptors, c );
+
+			char *service_name = NULL, *provider_name = NULL;
+			GstMpegtsDVBServiceType service_type;
+
+			if ( desc->tag != GST_MTS_DESC_DVB_SERVICE ) continue;
+
+			if ( !gst_mpegts_descriptor_parse_dvb_service ( desc, &service_type, &service_name, &provider_name ) ) continue;
+
+			if ( service_name ) _strip_ch_name ( service_name );
+
+			free ( service->name );
+			free ( service->provider );
+
+			service->name = service_name;
+			service->provider = provider_name;
+			service->type = (uint8_t)service_type;
+		}
+
+		g_debug ( "%s:: sid %u: %s ", __func__, service->sid, service->name );
+	}
+}
+
+static void scan_tables_vct ( ScanTables *tables, GstMpegtsSection *section )
+{
+	const GstMpegtsAtscVCT *vct = ( GST_MPEGTS_SECTION_TYPE (section) == GST_MPEGTS_SECTION_ATSC_CVCT ) 
+		? gst_mpegts_section_get_atsc_cvct ( section ) : gst_mpegts_section_get_atsc_tvct ( section );
+
+	if ( !vct ) return;
+
+	uint i = 0; for ( i = 0; i < vct->sources->len; i++ )
+	{
+		GstMpegtsAtscVCTSource *source = g_ptr_array_index ( vct->sources, i );
+
+		ScanService *service = scan_tables_service ( tables, source->program_number );
+
+		free ( service->name );
+		service->name = g_strdup ( source->short_name );
+
+		_strip_ch_name ( service->name );
+
+		service->type = source->service_type;
+
+		if ( source->access_controlled ) service->ca = TRUE;
+	}
+}
+
+static int scan_tables_rolloff ( GstMpegtsSatelliteRolloff rolloff )
+{
+	if ( rolloff == GST_MPEGTS_ROLLOFF_20 ) return ROLLOFF_20;
+	if ( rolloff == GST_MPEGTS_ROLLOFF_25 ) return ROLLOFF_25;
+	if ( rolloff == GST_MPEGTS_ROLLOFF_35 ) return ROLLOFF_35;
+
+	return ROLLOFF_AUTO;
+}
+
+/* The mpegts modulation, code rate, guard, mode and hierarchy enums follow linux/dvb/frontend.h */
+static char * scan_tables_delivery ( GstMpegtsDescriptor *desc )
+{
+	GstMpegtsTerrestrialDeliverySystemDescriptor ter;
+	GstMpegtsSatelliteDeliverySystemDescriptor sat;
+	GstMpegtsCableDeliverySystemDescriptor cab;
+
+	if ( desc->tag == GST_MTS_DESC_DVB_TERRESTRIAL_DELIVERY_SYSTEM && gst_mpegts_descriptor_parse_terrestrial_delivery_system ( desc, &ter ) )
+	{
+		return g_strdup_printf ( ":delsys=%d:frequency=%u:bandwidth-hz=%u:modulation=%d:code-rate-hp=%d:code-rate-lp=%d:guard=%d:trans-mode=%d:hierarchy=%d",
+			SYS_DVBT, ter.frequency, ter.bandwidth, ter.constellation, ter.code_rate_hp, ter.code_rate_lp, ter.guard_interval, ter.transmission_mode, ter.hierarchy );
+	}
+
+	if ( desc->tag == GST_MTS_DESC_DVB_SATELLITE_DELIVERY_SYSTEM && gst_mpegts_descriptor_parse_satellite_delivery_system ( desc, &sat ) )
+	{
+		gboolean pol_v = ( sat.polarization == GST_MPEGTS_POLARIZATION_LINEAR_VERTICAL || sat.polarization == GST_MPEGTS_POLARIZATION_CIRCULAR_RIGHT );
+
+		return g_strdup_printf ( ":delsys=%d:frequency=%u:polarity=%s:symbol-rate=%u:modulation=%d:code-rate-hp=%d:rolloff=%d",
+			( sat.modulation_system ) ? SYS_DVBS2 : SYS_DVBS, sat.frequency, ( pol_v ) ? "V" : "H", sat.symbol_rate, sat.modulation_type, sat.fec_inner, scan_tables_rolloff ( sat.roll_off ) );
+	}
+
+	if ( desc->tag == GST_MTS_DESC_DVB_CABLE_DELIVERY_SYSTEM && gst_mpegts_descriptor_parse_cable_delivery_system ( desc, &cab ) )
+	{
+		return g_strdup_printf ( ":delsys=%d:frequency=%u:symbol-rate=%u:modulation=%d:code-rate-hp=%d",
+			SYS_DVBC_ANNEX_A, cab.frequency, cab.symbol_rate, cab.modulation, cab.fec_inner );
+	}
+
+	return NULL;
+}
+
+static void scan_tables_nit ( ScanTables *tables, GstMpegtsSection *section )
+{
+	const GstMpegtsNIT *nit = gst_mpegts_section_get_nit ( section );
+
+	if ( !nit ) return;
+
+	uint i = 0, c = 0;
+
+	for ( i = 0; i < nit->streams->len; i++ )
+	{
+		GstMpegtsNITStream *stream = g_ptr_array_index ( nit->streams, i );
+
+		for ( c = 0; c < stream->descriptors->len; c++ )
+		{
+			char *tp = scan_tables_delivery ( g_ptr_array_index ( stream->descriptors, c ) );
+
+			if ( !tp ) continue;
+
+			g_debug ( "%s:: ts %u: %s ", __func__, stream->transport_stream_id, tp );
+
+			g_ptr_array_add ( tables->tps, tp );
+		}
+	}
+}
+
+gboolean scan_tables_parse ( ScanTables *tables, GstMessage *message )
+{
+	GstMpegtsSection *section = gst_message_parse_mpegts_section ( message );
+
+	if ( !section ) return FALSE;
+
+	switch ( GST_MPEGTS_SECTION_TYPE ( section ) )
+	{
+		case GST_MPEGTS_SECTION_PAT:
+			if ( scan_secs_add ( &tables->pat, section ) ) scan_tables_pat ( tables, section );
+			break;
+
+		case GST_MPEGTS_SECTION_PMT:
+			scan_tables_pmt ( tables, section );
+			break;
+
+		case GST_MPEGTS_SECTION_SDT:
+			if ( section->table_id == GST_MTS_TABLE_ID_SERVICE_DESCRIPTION_ACTUAL_TS && scan_secs_add ( &tables->sdt, section ) ) scan_tables_sdt ( tables, section );
+			break;
+
+		case GST_MPEGTS_SECTION_ATSC_CVCT:
+		case GST_MPEGTS_SECTION_ATSC_TVCT:
+			tables->vct = TRUE;
+			if ( scan_secs_add ( &tables->sdt, section ) ) scan_tables_vct ( tables, section );
+			break;
+
+		case GST_MPEGTS_SECTION_NIT:
+			if ( section->table_id == GST_MTS_TABLE_ID_NETWORK_INFORMATION_ACTUAL_NETWORK && scan_secs_add ( &tables->nit, section ) ) scan_tables_nit ( tables, section );
+			break;
+
+		default:
+			break;
+	}
+
+	gst_mpegts_section_unref ( section );
+
+	return TRUE;
+}
+
+gboolean scan_tables_complete ( ScanTables *tables, gboolean need_nit )
+{
+	if ( !scan_secs_done ( &tables->pat ) || !scan_secs_done ( &tables->sdt ) ) return FALSE;
+
+	/* ATSC carries no NIT */
+	if ( need_nit && !tables->vct && !scan_secs_done ( &tables->nit ) ) return FALSE;
+
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init ( &iter, tables->services );
+
+	while ( g_hash_table_iter_next ( &iter, &key, &value ) )
+	{
+		ScanService *service = value;
+
+		if ( service->pat && !service->pmt ) return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int scan_tables_cmp ( gconstpointer a, gconstpointer b )
+{
+	const ScanService *sa = *(ScanService * const *)a;
+	const ScanService *sb = *(ScanService * const *)b;
+
+	return (int)sa->sid - (int)sb->sid;
+}
+
+uint scan_tables_emit ( ScanTables *tables, GstElement *dvbsrc, ScanFound found, gpointer data )
+{
+	GString *gstr_data = g_string_new ( NULL );
+
+	Descr *descr = descr_new ();
+
+	g_signal_emit_by_name ( descr, "descr-get-tp", gstr_data, dvbsrc );
+
+	g_object_unref ( descr );
+
+	GPtrArray *list = g_ptr_array_new ();
+
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init ( &iter, tables->services );
+
+	while ( g_hash_table_iter_next ( &iter, &key, &value ) ) g_ptr_array_add ( list, value );
+
+	g_ptr_array_sort ( list, scan_tables_cmp );
+
+	uint i = 0; for ( i = 0; i < list->len; i++ )
+	{
+		ScanService *service = g_ptr_array_index ( list, i );
+
+		g_autofree char *name = ( service->name && service->name[0] ) ? g_strdup ( service->name ) : g_strdup_printf ( "Program %u", service->sid );
+
+		GString *gstring = g_string_new ( NULL );
+
+		g_string_append_printf ( gstring, "%s:program-number=%u", name, service->sid );
+
+		if ( service->video_pid ) g_string_append_printf ( gstring, ":video-pid=%u", service->video_pid );
+		if ( service->audio_pid ) g_string_append_printf ( gstring, ":audio-pid=%u", service->audio_pid );
+
+		g_string_append_printf ( gstring, ":service-type=%u:scrambled=%d%s", service->type, service->ca, gstr_data->str );
+
+		g_message ( "  Service: %u | %s | %s %s ", service->sid, name, ( service->provider ) ? service->provider : "", ( service->ca ) ? "( CA )" : "" );
+
+		found ( name, gstring->str, data );
+
+		g_string_free ( gstring, TRUE );
+	}
+
+	g_message ( "Services: %u \n", list->len );
+
+	uint ret = list->len;
+
+	g_ptr_array_unref ( list );
+	g_string_free ( gstr_data, TRUE );
+
+	return ret;
+}
+
+/* "sid=version,..." by sid; NULL until the PAT is complete and every program has its PMT */
+char * scan_tables_get_pmt_versions ( ScanTables *tables )
+{
+	if ( !scan_secs_done ( &tables->pat ) ) return NULL;
+
+	GPtrArray *list = g_ptr_array_new ();
+
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init ( &iter, tables->services );
+
+	while ( g_hash_table_iter_next ( &iter, &key, &value ) )
+	{
+		ScanService *service = value;
+
+		if ( !service->pat ) continue;
+
+		if ( !service->pmt ) { g_ptr_array_unref ( list ); return NULL; }
+
+		g_ptr_array_add ( list, service );
+	}
+
+	g_ptr_array_sort ( list, scan_tables_cmp );
+
+	GString *gstring = g_string_new ( NULL );
+
+	uint i = 0; for ( i = 0; i < list->len; i++ )
+	{
+		ScanService *service = g_ptr_array_index ( list, i );
+
+		g_string_append_printf ( gstring, "%s%u=%u", ( i ) ? "," : "", service->sid, service->pmt_version );
+	}
+
+	g_ptr_array_unref ( list );
+
+	return g_string_free ( gstring, FALSE );
+}
+
+GPtrArray * scan_tables_get_tps ( ScanTables *tables )
+{
+	return tables->tps;
+}
+
+/* Returns -1 until a section of the table has been seen */
+int scan_tables_get_version ( ScanTables *tables, uint8_t table )
+{
+	const ScanSecs *secs = ( table == SCAN_TABLE_PAT ) ? &tables->pat : ( table == SCAN_TABLE_SDT ) ? &tables->sdt : &tables->nit;
+
+	return ( secs->init ) ? secs->version : -1;
+}
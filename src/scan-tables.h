@@ -0,0 +1,41 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+
+typedef void ( *ScanFound ) ( const char *, const char *, gpointer );
+
+typedef struct _ScanTables ScanTables;
+
+enum scan_table_n
+{
+	SCAN_TABLE_PAT,
+	SCAN_TABLE_SDT,
+	SCAN_TABLE_NIT
+};
+
+void scan_tables_mpegts_init ( void );
+
+ScanTables * scan_tables_new ( void );
+
+gboolean scan_tables_parse ( ScanTables *, GstMessage * );
+
+gboolean scan_tables_complete ( ScanTables *, gboolean );
+
+uint scan_tables_emit ( ScanTables *, GstElement *, ScanFound, gpointer );
+
+GPtrArray * scan_tables_get_tps ( ScanTables * );
+
+int scan_tables_get_version ( ScanTables *, uint8_t );
+
+char * scan_tables_get_pmt_versions ( ScanTables * );
+
+void scan_tables_free ( ScanTables * );
@@ -12,16 +12,13 @@
 #include "level.h"
 #include "convert.h"
 #include "dvb-linux.h"
+#include "scan-engine.h"
+#include "ts-file.h"
 
 #include <stdlib.h>
 #include <gst/gst.h>
 #include <linux/dvb/frontend.h>
 
-#define GST_USE_UNSTABLE_API
-#include <gst/mpegts/mpegts.h>
-
-#define MAX_PAT 128
-
 /* DVB-T/T2, DVB-S/S2, DVB-C */
 
 enum cols_scan_n
@@ -43,6 +40,10 @@ struct _Scan
 
 	GstElement *dvbscan;
 	GstElement *dvbsrc;
+
+	ScanEngine *engine;
+	ScanTables *tables;
+	uint src_list;
 };
 
 G_DEFINE_TYPE ( Scan, scan, GTK_TYPE_WINDOW )
@@ -81,160 +82,6 @@ const ScanDelSys scan_delsys_type_n[] =
 	{ SYS_DTMB, 		"DTMB" 		}
 };
 
-static void scan_stop ( GtkButton *, Scan * );
-
-static void scan_add_treeview ( const char *, const char *, GtkTreeView * );
-
-static void _strip_ch_name ( char *name )
-{
-	uint8_t i = 0; for ( i = 0; name[i] != '\0'; i++ )
-	{
-		if ( name[i] == ':' || name[i] == '/' || name[i] == '\'' ) name[i] = ' ';
-	}
-
-	g_strstrip ( name );
-}
-
-static void mpegts_initialize ( void )
-{
-	gst_mpegts_initialize ();
-
-	g_type_class_ref ( GST_TYPE_MPEGTS_SECTION_TYPE );
-	g_type_class_ref ( GST_TYPE_MPEGTS_SECTION_TABLE_ID );
-}
-
-static void mpegts_sdt ( GstMpegtsSection *section, GtkTreeView *tree_view, GstElement *dvbsrc, Scan *scan )
-{
-	const GstMpegtsSDT *sdt = gst_mpegts_section_get_sdt ( section );
-
-	uint8_t i = 0, c = 0, len = (uint8_t)sdt->services->len;
-
-	GString *gstr_data = g_string_new ( NULL );
-
-	Descr *descr = descr_new ();
-
-	g_signal_emit_by_name ( descr, "descr-get-tp", gstr_data, dvbsrc );
-
-	g_message ( "SDT: %u Services \n", len );
-
-	for ( i = 0; i < len; i++ )
-	{
-		if ( i >= MAX_PAT ) { g_print ( "MAX_PAT %u: Sdt stop  \n", MAX_PAT ); break; }
-
-		GstMpegtsSDTService *service = g_ptr_array_index ( sdt->services, i );
-
-		g_message ( "  Service id:  %u | %u ( 0x%04x ) ", i+1, service->service_id, service->service_id );
-
-		GPtrArray *descriptors = service->descriptors;
-
-		for ( c = 0; c < descriptors->len; c++ )
-		{
-			GstMpegtsDescriptor *desc = g_ptr_array_index ( descriptors, c );
-
-			char *service_name, *provider_name;
-			GstMpegtsDVBServiceType service_type;
-
-			if ( desc->tag == GST_MTS_DESC_DVB_SERVICE )
-			{
-				if ( gst_mpegts_descriptor_parse_dvb_service ( desc, &service_type, &service_name, &provider_name ) )
-				{
-					_strip_ch_name ( service_name );
-
-					GString *gstring = g_string_new ( NULL );
-					g_string_append_printf ( gstring, "%s:program-number=%d%s", service_name, service->service_id, gstr_data->str );
-
-					scan_add_treeview ( service_name, gstring->str, tree_view );
-
-					g_message ( "    Service  : %s ", service_name );
-					g_message ( "    Provider : %s \n", provider_name );
-
-					free ( service_name  );
-					free ( provider_name );
-					g_string_free ( gstring, TRUE );
-				}
-			}
-		}
-	}
-
-	g_object_unref ( descr );
-	g_string_free ( gstr_data, TRUE );
-
-	g_message ( "SDT Done \n" );
-
-	scan_stop ( NULL, scan );
-}
-
-static void mpegts_vct ( GstMpegtsSection *section, GtkTreeView *tree_view, GstElement *dvbsrc, Scan *scan )
-{
-	const GstMpegtsAtscVCT *vct = ( GST_MPEGTS_SECTION_TYPE (section) == GST_MPEGTS_SECTION_ATSC_CVCT ) 
-		? gst_mpegts_section_get_atsc_cvct ( section ) : gst_mpegts_section_get_atsc_tvct ( section );
-
-	uint8_t i = 0, len = (uint8_t)vct->sources->len;
-
-	GString *gstr_data = g_string_new ( NULL );
-
-	Descr *descr = descr_new ();
-
-	g_signal_emit_by_name ( descr, "descr-get-tp", gstr_data, dvbsrc );
-
-	g_message ( "VCT: %u Sources \n", len );
-
-	for ( i = 0; i < len; i++ )
-	{
-		if ( i >= MAX_PAT ) { g_print ( "MAX_PAT %u: Vct stop  \n", MAX_PAT ); break; }
-
-		GstMpegtsAtscVCTSource *source = g_ptr_array_index ( vct->sources, i );
-
-		g_message ( "  Service id:  %u | %u ( 0x%04x ) ", i+1, source->program_number, source->program_number );
-
-		char *name = g_strdup ( source->short_name );
-
-		_strip_ch_name ( name );
-
-		GString *gstring = g_string_new ( NULL );
-		g_string_append_printf ( gstring, "%s:program-number=%d%s", name, source->program_number, gstr_data->str );
-
-		scan_add_treeview ( name, gstring->str, tree_view );
-
-		g_message ( "    Service ( short name ) : %s \n", source->short_name );
-
-		free ( name );
-		g_string_free ( gstring, TRUE );
-	}
-
-	g_object_unref ( descr );
-	g_string_free ( gstr_data, TRUE );
-
-	g_message ( "VCT Done \n" );
-
-	scan_stop ( NULL, scan );
-}
-
-static void mpegts_parse_section ( GstMessage *message, GtkTreeView *tree_view, GstElement *dvbsrc, Scan *scan )
-{
-	GstMpegtsSection *section = gst_message_parse_mpegts_section ( message );
-
-	if ( section )
-	{
-		switch ( GST_MPEGTS_SECTION_TYPE ( section ) )
-		{
-			case GST_MPEGTS_SECTION_SDT:
-				mpegts_sdt ( section, tree_view, dvbsrc, scan );
-				break;
-
-			case GST_MPEGTS_SECTION_ATSC_CVCT:
-			case GST_MPEGTS_SECTION_ATSC_TVCT:
-				mpegts_vct ( section, tree_view, dvbsrc, scan );
-				break;
-
-			default:
-			break;
-		}
-
-		gst_mpegts_section_unref ( section );
-	}
-}
-
 static void scan_message_dialog ( const char *f_error, const char *file_or_info, GtkMessageType mesg_type, Scan *scan )
 {
 	GtkMessageDialog *dialog = ( GtkMessageDialog *)gtk_message_dialog_new ( GTK_WINDOW ( scan ), GTK_DIALOG_MODAL, mesg_type, GTK_BUTTONS_CLOSE, "%s\n%s",  f_error, file_or_info );
@@ -282,6 +129,10 @@ static void scan_stop ( G_GNUC_UNUSED GtkButton *button, Scan *scan )
 {
 	if ( GST_ELEMENT_CAST ( scan->dvbscan )->current_state == GST_STATE_NULL ) return;
 
+	if ( scan->tables ) scan_tables_emit ( scan->tables, scan->dvbsrc, (ScanFound)scan_add_treeview, scan->treeview );
+	if ( scan->tables ) scan_tables_free ( scan->tables );
+	scan->tables = NULL;
+
 	if ( scan->level && GTK_IS_WIDGET ( scan->level ) ) g_signal_emit_by_name ( scan->level, "level-update", 0, 0, FALSE, FALSE );
 
 	gst_element_set_state ( scan->dvbscan, GST_STATE_NULL );
@@ -289,8 +140,13 @@ static void scan_stop ( G_GNUC_UNUSED GtkButton *button, Scan *scan )
 
 static void scan_start ( G_GNUC_UNUSED GtkButton *button, Scan *scan )
 {
+	if ( scan->src_list ) return;
+
 	if ( GST_ELEMENT_CAST ( scan->dvbscan )->current_state == GST_STATE_PLAYING ) return;
 
+	if ( scan->tables ) scan_tables_free ( scan->tables );
+	scan->tables = scan_tables_new ();
+
 	gst_element_set_state ( scan->dvbscan, GST_STATE_PLAYING );
 }
 
@@ -557,6 +413,92 @@ static GtkBox * scan_convert ( Scan *scan )
 	return g_box;
 }
 
+static gboolean scan_list_progress ( Scan *scan )
+{
+	char text[100];
+	sprintf ( text, "Transponders left: %u", scan_engine_get_left ( scan->engine ) );
+
+	gtk_label_set_text ( scan->label_device, text );
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void scan_list_found ( const char *name, const char *data, Scan *scan )
+{
+	scan_add_treeview ( name, data, scan->treeview );
+}
+
+static void scan_list_done ( Scan *scan )
+{
+	if ( scan->src_list ) g_source_remove ( scan->src_list );
+	scan->src_list = 0;
+
+	scan_set_new_device ( scan );
+
+	if ( scan_engine_get_no_tuner ( scan->engine ) ) scan_message_dialog ( "", "No free tuner.", GTK_MESSAGE_WARNING, scan );
+}
+
+static void scan_list_file ( const char *file, Scan *scan )
+{
+	if ( scan->src_list ) { scan_engine_stop ( scan->engine ); scan_list_done ( scan ); return; }
+
+	int adapter = 0, frontend = 0;
+	g_object_get ( scan->dvbsrc, "adapter",  &adapter,  NULL );
+	g_object_get ( scan->dvbsrc, "frontend", &frontend, NULL );
+
+	if ( !scan_engine_load ( scan->engine, file, (uint)adapter, (uint)frontend ) )
+		{ scan_message_dialog ( file, "No transponders.", GTK_MESSAGE_WARNING, scan ); return; }
+
+	scan_stop ( NULL, scan );
+
+	scan->src_list = g_timeout_add_seconds ( 1, (GSourceFunc)scan_list_progress, scan );
+	scan_list_progress ( scan );
+
+	scan_engine_start ( scan->engine );
+}
+
+static void scan_list_set_file ( GtkEntry *entry, GtkEntryIconPosition icon_pos, G_GNUC_UNUSED GdkEventButton *event, Scan *scan )
+{
+	if ( icon_pos == GTK_ENTRY_ICON_PRIMARY )
+	{
+		char *file = scan_open_file ( "/usr/share/dvb", GTK_WINDOW ( scan ) );
+
+		if ( file == NULL ) return;
+
+		gtk_entry_set_text ( entry, file );
+
+		free ( file );
+	}
+
+	if ( icon_pos == GTK_ENTRY_ICON_SECONDARY ) scan_list_file ( gtk_entry_get_text ( entry ), scan );
+}
+
+static GtkBox * scan_list ( Scan *scan )
+{
+	GtkBox *g_box  = (GtkBox *)gtk_box_new ( GTK_ORIENTATION_VERTICAL, 0 );
+	gtk_widget_set_visible ( GTK_WIDGET ( g_box ), TRUE );
+
+	GtkLabel *label = (GtkLabel *)gtk_label_new ( "Initial scan  ⇨  All transponders" );
+	gtk_widget_set_visible ( GTK_WIDGET ( label ), TRUE );
+	gtk_box_pack_start ( g_box, GTK_WIDGET ( label ), FALSE, FALSE, 5 );
+
+	GtkEntry *entry = (GtkEntry *)gtk_entry_new ();
+	gtk_entry_set_text ( entry, "dvbv5 scan file" );
+	gtk_widget_set_visible ( GTK_WIDGET ( entry ), TRUE );
+
+	gtk_widget_set_margin_end   ( GTK_WIDGET ( entry ), 10 );
+	gtk_widget_set_margin_start ( GTK_WIDGET ( entry ), 10 );
+
+	g_object_set ( entry, "editable", FALSE, NULL );
+	gtk_entry_set_icon_from_icon_name ( entry, GTK_ENTRY_ICON_PRIMARY, "folder" );
+	gtk_entry_set_icon_from_icon_name ( entry, GTK_ENTRY_ICON_SECONDARY, "helia-play" );
+	g_signal_connect ( entry, "icon-press", G_CALLBACK ( scan_list_set_file ), scan );
+
+	gtk_box_pack_start ( g_box, GTK_WIDGET ( entry ), FALSE, FALSE, 5 );
+
+	return g_box;
+}
+
 static void scan_device ( GtkBox *box, Scan *scan )
 {
 	int adapter = 0, frontend = 0, delsys = 0;
@@ -617,6 +559,7 @@ static void scan_device ( GtkBox *box, Scan *scan )
 	gtk_grid_attach ( grid, GTK_WIDGET ( combo_delsys ), 1, d-1, 1, 1 );
 
 	gtk_box_pack_start ( box, GTK_WIDGET ( scan_convert ( scan ) ), TRUE, TRUE, 10 );
+	gtk_box_pack_start ( box, GTK_WIDGET ( scan_list    ( scan ) ), TRUE, TRUE, 10 );
 
 	scan_create_control_battons ( box, scan );
 }
@@ -644,7 +587,7 @@ static void scan_msg_all ( G_GNUC_UNUSED GstBus *bus, GstMessage *message, Scan
 		}
 	}
 
-	mpegts_parse_section ( message, scan->treeview, scan->dvbsrc, scan );
+	if ( scan->tables && scan_tables_parse ( scan->tables, message ) && scan_tables_complete ( scan->tables, FALSE ) ) scan_stop ( NULL, scan );
 }
 
 static void scan_msg_err ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, Scan *scan )
@@ -681,12 +624,12 @@ static void scan_set_tune_timeout ( GstElement *element, guint64 time_set )
 
 static void scan_create ( Scan *scan )
 {
-	mpegts_initialize ();
+	scan->engine = scan_engine_new ( (ScanFound)scan_list_found, (GDestroyNotify)scan_list_done, scan );
 
 	GstElement *tsparse, *filesink;
 
 	scan->dvbscan = gst_pipeline_new ( "pipeline-scan" );
-	scan->dvbsrc  = gst_element_factory_make ( "dvbsrc",   NULL );
+	scan->dvbsrc  = ts_file_make_src ();
 	tsparse       = gst_element_factory_make ( "tsparse",  NULL );
 	filesink      = gst_element_factory_make ( "fakesink", NULL );
 
@@ -708,6 +651,14 @@ static void scan_create ( Scan *scan )
 
 static void scan_window_quit ( G_GNUC_UNUSED GtkWindow *window, Scan *scan )
 {
+	if ( scan->src_list ) g_source_remove ( scan->src_list );
+	scan->src_list = 0;
+
+	scan_engine_free ( scan->engine );
+
+	if ( scan->tables ) scan_tables_free ( scan->tables );
+	scan->tables = NULL;
+
 	gst_element_set_state ( scan->dvbscan, GST_STATE_NULL );
 
 	gst_object_unref ( scan->dvbscan );
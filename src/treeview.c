@@ -8,17 +8,13 @@
 */
 
 #include "treeview.h"
+#include "epg.h"
+#include "epg-harvest.h"
+#include "chan-model.h"
+#include "scan-cache.h"
 
 #include <stdlib.h>
 
-enum cols_n
-{
-	COL_NUM,
-	COL_FLCH,
-	COL_DATA,
-	NUM_COLS
-};
-
 typedef void ( *fpt ) ( GtkButton *, GtkTreeView * );
 
 static void add_filter ( GtkFileChooserDialog *dialog, const char *name, const char *filter_set )
@@ -53,58 +49,45 @@ static char * save_dialog ( const char *dir, const char *file, const char *name_
 	return filename;
 }
 
-static void treeview_reread ( GtkTreeView *tree_view )
+static ChanModel * treeview_model ( GtkTreeView *tree_view )
 {
-	GtkTreeIter iter;
-	GtkTreeModel *model = gtk_tree_view_get_model ( tree_view );
-
-	int row_count = 1;
-	gboolean valid;
-
-	for ( valid = gtk_tree_model_get_iter_first ( model, &iter ); valid;
-		  valid = gtk_tree_model_iter_next ( model, &iter ) )
-	{
-		gtk_list_store_set ( GTK_LIST_STORE ( model ), &iter, COL_NUM, row_count++, -1 );
-	}
+	return CHAN_MODEL ( gtk_tree_view_get_model ( tree_view ) );
 }
 
 static void treeview_up_down ( gboolean up_dw, GtkTreeView *tree_view )
 {
 	GtkTreeIter iter;
-	GtkTreeModel *model = gtk_tree_view_get_model ( tree_view );
+	ChanModel *model = treeview_model ( tree_view );
 
-	int ind = gtk_tree_model_iter_n_children ( model, NULL );
+	uint ind = chan_model_get_n ( model );
 	if ( ind < 2 ) return;
 
 	if ( gtk_tree_selection_get_selected ( gtk_tree_view_get_selection ( tree_view ), NULL, &iter ) )
 	{
-		GtkTreeIter *iter_c = gtk_tree_iter_copy ( &iter );
+		uint index = chan_model_iter_index ( &iter );
+
+		if ( up_dw  && index == 0 ) return;
+		if ( !up_dw && index + 1 >= ind ) return;
 
-		if ( up_dw )
-		if ( gtk_tree_model_iter_previous ( model, &iter ) )
-			gtk_list_store_move_before ( GTK_LIST_STORE ( model ), iter_c, &iter );
+		uint index_to = ( up_dw ) ? index - 1 : index + 1;
 
-		if ( !up_dw )
-		if ( gtk_tree_model_iter_next ( model, &iter ) )
-			gtk_list_store_move_after ( GTK_LIST_STORE ( model ), iter_c, &iter );
+		chan_model_swap ( model, index, index_to );
 
-		gtk_tree_iter_free ( iter_c );
+		GtkTreePath *path = gtk_tree_path_new_from_indices ( (int)index_to, -1 );
 
-		treeview_reread ( tree_view );
+		gtk_tree_selection_select_path ( gtk_tree_view_get_selection ( tree_view ), path );
+		gtk_tree_view_scroll_to_cell ( tree_view, path, NULL, FALSE, 0, 0 );
+
+		gtk_tree_path_free ( path );
 	}
 }
 
 static void treeview_remove ( G_GNUC_UNUSED GtkButton *button, GtkTreeView *tree_view )
 {
 	GtkTreeIter iter;
-	GtkTreeModel *model = gtk_tree_view_get_model ( tree_view );
 
 	if ( gtk_tree_selection_get_selected ( gtk_tree_view_get_selection ( tree_view ), NULL, &iter ) )
-	{
-		gtk_list_store_remove ( GTK_LIST_STORE ( model ), &iter );
-
-		treeview_reread ( tree_view );
-	}
+		chan_model_remove ( treeview_model ( tree_view ), chan_model_iter_index ( &iter ) );
 }
 
 static void treeview_goup ( G_GNUC_UNUSED GtkButton *button, GtkTreeView *tree_view )
@@ -119,35 +102,30 @@ static void treeview_down ( G_GNUC_UNUSED GtkButton *button, GtkTreeView *tree_v
 
 static void treeview_clear ( G_GNUC_UNUSED GtkButton *button, GtkTreeView *tree_view )
 {
-	gtk_list_store_clear ( GTK_LIST_STORE ( gtk_tree_view_get_model ( tree_view ) ) );
+	chan_model_clear ( treeview_model ( tree_view ) );
 }
 
 static void treeview_save ( const char *file, GtkTreeView *tree_view )
 {
-	GString *gstring = g_string_new ( "# Gtv-Dvb channel format \n" );
+	ChanModel *model = treeview_model ( tree_view );
 
-	GtkTreeIter iter;
-	GtkTreeModel *model = gtk_tree_view_get_model ( tree_view );
-
-	int ind = gtk_tree_model_iter_n_children ( model, NULL );
+	uint i = 0, ind = chan_model_get_n ( model );
 
 	if ( ind == 0 ) return;
 
-	gboolean valid;
-	for ( valid = gtk_tree_model_get_iter_first ( model, &iter ); valid; valid = gtk_tree_model_iter_next ( model, &iter ) )
-	{
-		char *data = NULL;
-
-		gtk_tree_model_get ( model, &iter, 2, &data, -1 );
+	GString *gstring = g_string_new ( "# Gtv-Dvb channel format \n" );
 
-		g_string_append_printf ( gstring, "%s\n", data );
+	for ( i = 0; i < ind; i++ )
+	{
+		const DvbChan *chan = chan_model_get ( model, i );
 
-		free ( data );
+		g_string_append ( gstring, chan->data );
+		g_string_append_c ( gstring, '\n' );
 	}
 
 	GError *err = NULL;
 
-	if ( !g_file_set_contents ( file, gstring->str, -1, &err ) )
+	if ( !g_file_set_contents ( file, gstring->str, (gssize)gstring->len, &err ) )
 	{
 		g_critical ( "%s: %s ", __func__, err->message );
 		g_error_free ( err );
@@ -158,11 +136,7 @@ static void treeview_save ( const char *file, GtkTreeView *tree_view )
 
 static void treeview_save_dvb ( GtkButton *button, GtkTreeView *treeview )
 {
-	GtkTreeModel *model = gtk_tree_view_get_model ( treeview );
-
-	int ind = gtk_tree_model_iter_n_children ( model, NULL );
-
-	if ( ind == 0 ) return;
+	if ( chan_model_get_n ( treeview_model ( treeview ) ) == 0 ) return;
 
 	GtkWindow *window = GTK_WINDOW ( gtk_widget_get_toplevel ( GTK_WIDGET ( button ) ) );
 
@@ -173,54 +147,113 @@ static void treeview_save_dvb ( GtkButton *button, GtkTreeView *treeview )
 	treeview_save ( path, treeview );
 }
 
+typedef struct _TreeLoad TreeLoad;
+
+struct _TreeLoad
+{
+	GMappedFile *map;
+
+	const char *pos;
+	const char *end;
+};
+
 struct _TreeDvb
 {
 	GtkBox parent_instance;
 
 	GtkTreeView *treeview;
+	ChanModel *model;
+
+	GtkWidget *box_edit;
+
+	GQueue *loads;
+	uint load_id;
+
+	EpgHarvest *harvest;
+	uint harvest_id;
 };
 
 G_DEFINE_TYPE ( TreeDvb, treedvb, GTK_TYPE_BOX )
 
-static void treeview_append_dvb ( const char *name, const char *data, GtkTreeView *treeview )
+/* The model stays attached: rows are appended with row-inserted and the view is in fixed-height mode */
+static gboolean treeview_load_batch ( TreeLoad *load, TreeDvb *treedvb )
 {
-	GtkTreeIter iter;
-	GtkTreeModel *model = gtk_tree_view_get_model ( treeview );
-
-	int ind = gtk_tree_model_iter_n_children ( model, NULL );
+	return chan_model_load ( treedvb->model, &load->pos, load->end, CHAN_LOAD_BATCH );
+}
 
-	gtk_list_store_append ( GTK_LIST_STORE ( model ), &iter );
-	gtk_list_store_set    ( GTK_LIST_STORE ( model ), &iter, COL_NUM, ind+1, COL_FLCH, name, COL_DATA, data, -1 );
+static void treeview_load_free ( TreeLoad *load )
+{
+	g_mapped_file_unref ( load->map );
+	free ( load );
 }
 
-static void treeview_add_channels_dvb ( const char *file, GtkTreeView *treeview )
+static gboolean treeview_load_idle ( TreeDvb *treedvb )
 {
-	char  *contents = NULL;
-	GError *err     = NULL;
+	TreeLoad *load = g_queue_peek_head ( treedvb->loads );
 
-	if ( g_file_get_contents ( file, &contents, 0, &err ) )
-	{
-		char **lines = g_strsplit ( contents, "\n", 0 );
+	if ( load && treeview_load_batch ( load, treedvb ) ) return G_SOURCE_CONTINUE;
 
-		uint i = 0; for ( i = 0; lines[i] != NULL; i++ )
-		{
-			if ( g_str_has_prefix ( lines[i], "#" ) || strlen ( lines[i] ) < 2 ) continue;
+	if ( load ) treeview_load_free ( g_queue_pop_head ( treedvb->loads ) );
 
-			char **data = g_strsplit ( lines[i], ":", 0 );
+	if ( !g_queue_is_empty ( treedvb->loads ) ) return G_SOURCE_CONTINUE;
 
-			treeview_append_dvb ( data[0], lines[i], treeview );
+	treedvb->load_id = 0;
 
-			g_strfreev ( data );
-		}
+	return G_SOURCE_REMOVE;
+}
+
+static void treeview_load_finish ( TreeDvb *treedvb )
+{
+	if ( treedvb->load_id ) g_source_remove ( treedvb->load_id );
+	treedvb->load_id = 0;
+
+	TreeLoad *load = NULL;
 
-		g_strfreev ( lines );
-		free ( contents );
+	while ( ( load = g_queue_pop_head ( treedvb->loads ) ) )
+	{
+		while ( treeview_load_batch ( load, treedvb ) );
+
+		treeview_load_free ( load );
 	}
-	else
+}
+
+static void treeview_add_channels_dvb ( const char *file, TreeDvb *treedvb )
+{
+	GError *err = NULL;
+
+	GMappedFile *map = g_mapped_file_new ( file, FALSE, &err );
+
+	if ( !map )
 	{
 		g_critical ( "%s:: ERROR: %s ", __func__, err->message );
 		g_error_free ( err );
+
+		return;
 	}
+
+	TreeLoad *load = g_new0 ( TreeLoad, 1 );
+
+	load->map = map;
+	load->pos = g_mapped_file_get_contents ( map );
+	load->end = load->pos + g_mapped_file_get_length ( map );
+
+	if ( g_queue_is_empty ( treedvb->loads ) && !treeview_load_batch ( load, treedvb ) ) { treeview_load_free ( load ); return; }
+
+	g_queue_push_tail ( treedvb->loads, load );
+
+	if ( !treedvb->load_id ) treedvb->load_id = g_idle_add ( (GSourceFunc)treeview_load_idle, treedvb );
+}
+
+static void treeview_search_changed ( GtkSearchEntry *entry, TreeDvb *treedvb )
+{
+	ChanModel *found = chan_model_filter ( treedvb->model, gtk_entry_get_text ( GTK_ENTRY ( entry ) ) );
+
+	gtk_tree_view_set_model ( treedvb->treeview, GTK_TREE_MODEL ( ( found ) ? found : treedvb->model ) );
+
+	if ( found ) g_object_unref ( found );
+
+	/* Edits and saves go to the full list only */
+	if ( treedvb->box_edit ) gtk_widget_set_sensitive ( treedvb->box_edit, !found );
 }
 
 static void treeview_row_activated_dvb ( GtkTreeView *tree_view, GtkTreePath *path, G_GNUC_UNUSED GtkTreeViewColumn *column, TreeDvb *treedvb )
@@ -280,6 +313,23 @@ static GtkBox * treeview_create_box_dvb ( TreeDvb *treedvb )
 	return h_box;
 }
 
+static void treeview_cache_found ( G_GNUC_UNUSED const char *name, const char *data, TreeDvb *treedvb )
+{
+	chan_model_append ( treedvb->model, dvb_chan_get ( data ) );
+}
+
+/* No channel list yet: rebuild it from the last scan without tuning */
+static void treeview_add_cache ( TreeDvb *treedvb )
+{
+	ScanCache *cache = scan_cache_new ();
+
+	uint num = scan_cache_foreach ( cache, (ScanFound)treeview_cache_found, treedvb );
+
+	if ( num ) g_message ( "%s:: %u channels from the scan cache ", __func__, num );
+
+	scan_cache_free ( cache );
+}
+
 static void treeview_set_dvb ( Level *level, TreeDvb *treedvb )
 {
 	gtk_widget_set_visible ( GTK_WIDGET ( level ), TRUE );
@@ -290,6 +340,7 @@ static void treeview_set_dvb ( Level *level, TreeDvb *treedvb )
 	gtk_box_pack_start ( GTK_BOX ( treedvb ), GTK_WIDGET ( level ), FALSE, FALSE, 0 );
 
 	GtkBox *vbox = treeview_create_box_dvb ( treedvb );
+	treedvb->box_edit = GTK_WIDGET ( vbox );
 
 	gtk_widget_set_margin_end    ( GTK_WIDGET ( vbox ), 5 );
 	gtk_widget_set_margin_start  ( GTK_WIDGET ( vbox ), 5 );
@@ -299,17 +350,20 @@ static void treeview_set_dvb ( Level *level, TreeDvb *treedvb )
 	char path[PATH_MAX];
 	sprintf ( path, "%s/helia/gtv-channel.conf", g_get_user_config_dir () );
 
-	treeview_add_channels_dvb ( path, treedvb->treeview );
+	if ( g_file_test ( path, G_FILE_TEST_EXISTS ) )
+		treeview_add_channels_dvb ( path, treedvb );
+	else
+		treeview_add_cache ( treedvb );
 }
 
 static void treedvb_handler_add ( TreeDvb *treedvb, const char *data )
 {
-	treeview_add_channels_dvb ( data, treedvb->treeview );
+	treeview_add_channels_dvb ( data, treedvb );
 }
 
-static void treedvb_handler_append ( TreeDvb *treedvb, const char *name, const char *data )
+static void treedvb_handler_append ( TreeDvb *treedvb, G_GNUC_UNUSED const char *name, const char *data )
 {
-	treeview_append_dvb ( name, data, treedvb->treeview );
+	chan_model_append ( treedvb->model, dvb_chan_get ( data ) );
 }
 
 static char * treedvb_handler_get ( TreeDvb *treedvb )
@@ -335,11 +389,103 @@ static void treedvb_save ( GtkTreeView *tree_view )
 	treeview_save ( path, tree_view );
 }
 
+/* Opt-in: the pool only yields to this process, not to a recording in helia --schedule */
+static gboolean treeview_harvest_enabled ( void )
+{
+	GSettingsSchemaSource *schemasrc = g_settings_schema_source_get_default ();
+
+	GSettingsSchema *schema = ( schemasrc ) ? g_settings_schema_source_lookup ( schemasrc, "org.gnome.helia", FALSE ) : NULL;
+
+	if ( schema == NULL ) return FALSE;
+
+	gboolean enabled = FALSE;
+
+	if ( g_settings_schema_has_key ( schema, "epg-harvest" ) )
+	{
+		GSettings *setting = g_settings_new ( "org.gnome.helia" );
+
+		enabled = g_settings_get_boolean ( setting, "epg-harvest" );
+
+		g_object_unref ( setting );
+	}
+
+	g_settings_schema_unref ( schema );
+
+	return enabled;
+}
+
+/* Idle tuners walk the transponders of the list for the EIT schedule */
+static gboolean treeview_harvest ( TreeDvb *treedvb )
+{
+	if ( !treeview_harvest_enabled () ) return G_SOURCE_CONTINUE;
+
+	uint i = 0, num = chan_model_get_n ( treedvb->model );
+
+	for ( i = 0; i < num; i++ ) epg_harvest_add ( treedvb->harvest, chan_model_get ( treedvb->model, i )->data );
+
+	epg_harvest_start ( treedvb->harvest );
+
+	return G_SOURCE_CONTINUE;
+}
+
 static void treedvb_destroy ( TreeDvb *treedvb )
 {
+	treeview_load_finish ( treedvb );
+
+	if ( treedvb->harvest_id ) g_source_remove ( treedvb->harvest_id );
+	treedvb->harvest_id = 0;
+
+	if ( treedvb->harvest ) epg_harvest_free ( treedvb->harvest );
+	treedvb->harvest = NULL;
+
+	gtk_tree_view_set_model ( treedvb->treeview, GTK_TREE_MODEL ( treedvb->model ) );
+
 	treedvb_save ( treedvb->treeview );
 }
 
+static void treeview_tooltip_event ( GString *gstring, const char *data, gint64 time, uint8_t when )
+{
+	EpgEvent event;
+
+	if ( !epg_get_event ( data, time, when, &event ) ) return;
+
+	GDateTime *date = g_date_time_new_from_unix_local ( event.start );
+	g_autofree char *start = g_date_time_format ( date, "%H:%M" );
+
+	g_string_append_printf ( gstring, "%s%s  %s", ( gstring->len ) ? "\n" : "", start, event.title );
+
+	g_date_time_unref ( date );
+	epg_event_clear ( &event );
+}
+
+static gboolean treeview_query_tooltip ( GtkTreeView *tree_view, int x, int y, gboolean keyboard, GtkTooltip *tooltip, G_GNUC_UNUSED TreeDvb *treedvb )
+{
+	GtkTreeIter iter;
+	GtkTreeModel *model = NULL;
+
+	if ( !gtk_tree_view_get_tooltip_context ( tree_view, &x, &y, keyboard, &model, NULL, &iter ) ) return FALSE;
+
+	g_autofree char *data = NULL;
+	gtk_tree_model_get ( model, &iter, COL_DATA, &data, -1 );
+
+	if ( !data ) return FALSE;
+
+	gint64 time = g_get_real_time () / G_USEC_PER_SEC;
+
+	GString *gstring = g_string_new ( NULL );
+
+	treeview_tooltip_event ( gstring, data, time, EPG_NOW  );
+	treeview_tooltip_event ( gstring, data, time, EPG_NEXT );
+
+	gboolean ret = ( gstring->len > 0 );
+
+	if ( ret ) gtk_tooltip_set_text ( tooltip, gstring->str );
+
+	g_string_free ( gstring, TRUE );
+
+	return ret;
+}
+
 static void treedvb_init ( TreeDvb *treedvb )
 {
 	GtkBox *v_box = GTK_BOX ( treedvb );
@@ -348,6 +494,11 @@ static void treedvb_init ( TreeDvb *treedvb )
 	gtk_box_set_spacing ( v_box, 5 );
 	gtk_widget_set_visible ( GTK_WIDGET ( v_box ), TRUE );
 
+	treedvb->loads = g_queue_new ();
+
+	treedvb->harvest = epg_harvest_new ();
+	treedvb->harvest_id = g_timeout_add_seconds ( 60, (GSourceFunc)treeview_harvest, treedvb );
+
 	GtkScrolledWindow *sw = (GtkScrolledWindow *)gtk_scrolled_window_new ( NULL, NULL );
 	gtk_scrolled_window_set_policy ( sw, GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC );
 	gtk_widget_set_size_request ( GTK_WIDGET ( sw ), 220, -1 );
@@ -355,8 +506,9 @@ static void treedvb_init ( TreeDvb *treedvb )
 
 	const char *title[3] = { "Num", "Channel", "Data" };
 
-	GtkListStore *store = (GtkListStore *)gtk_list_store_new ( NUM_COLS, G_TYPE_UINT, G_TYPE_STRING, G_TYPE_STRING );
-	treedvb->treeview = (GtkTreeView *)gtk_tree_view_new_with_model ( GTK_TREE_MODEL ( store ) );
+	treedvb->model = chan_model_new ();
+	treedvb->treeview = (GtkTreeView *)gtk_tree_view_new_with_model ( GTK_TREE_MODEL ( treedvb->model ) );
+	gtk_tree_view_set_fixed_height_mode ( treedvb->treeview, TRUE );
 	gtk_tree_view_set_search_column ( treedvb->treeview, COL_FLCH );
 
 	GtkCellRenderer *renderer;
@@ -368,18 +520,28 @@ static void treedvb_init ( TreeDvb *treedvb )
 
 		column = gtk_tree_view_column_new_with_attributes ( title[c], renderer, "text", c, NULL );
 
+		gtk_tree_view_column_set_sizing ( column, GTK_TREE_VIEW_COLUMN_FIXED );
+
+		if ( c == COL_NUM  ) gtk_tree_view_column_set_fixed_width ( column, 50 );
+		if ( c == COL_FLCH ) gtk_tree_view_column_set_expand ( column, TRUE );
 		if ( c == COL_DATA ) gtk_tree_view_column_set_visible ( column, FALSE );
 
 		gtk_tree_view_append_column ( treedvb->treeview, column );
 	}
 
-	g_object_unref ( G_OBJECT (store) );
-
 	gtk_widget_set_visible ( GTK_WIDGET ( treedvb->treeview ), TRUE );
 	g_signal_connect ( treedvb->treeview, "row-activated", G_CALLBACK ( treeview_row_activated_dvb ), treedvb );
 	g_signal_connect ( treedvb->treeview, "button-press-event", G_CALLBACK ( treeview_row_press_event_dvb ), treedvb );
 
+	gtk_widget_set_has_tooltip ( GTK_WIDGET ( treedvb->treeview ), TRUE );
+	g_signal_connect ( treedvb->treeview, "query-tooltip", G_CALLBACK ( treeview_query_tooltip ), treedvb );
+
+	GtkSearchEntry *entry = (GtkSearchEntry *)gtk_search_entry_new ();
+	gtk_widget_set_visible ( GTK_WIDGET ( entry ), TRUE );
+	g_signal_connect ( entry, "search-changed", G_CALLBACK ( treeview_search_changed ), treedvb );
+
 	gtk_container_add ( GTK_CONTAINER ( sw ), GTK_WIDGET ( treedvb->treeview ) );
+	gtk_box_pack_start ( v_box, GTK_WIDGET ( entry ), FALSE, FALSE, 0 );
 	gtk_box_pack_start ( v_box, GTK_WIDGET ( sw ), TRUE, TRUE, 0 );
 
 	g_signal_connect ( treedvb, "destroy",          G_CALLBACK ( treedvb_destroy     ), NULL );
@@ -390,6 +552,11 @@ static void treedvb_init ( TreeDvb *treedvb )
 
 static void treedvb_finalize ( GObject *object )
 {
+	TreeDvb *treedvb = TREEDVB_BOX ( object );
+
+	g_queue_free ( treedvb->loads );
+	g_object_unref ( treedvb->model );
+
 	G_OBJECT_CLASS ( treedvb_parent_class )->finalize ( object );
 }
 
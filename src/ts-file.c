@@ -0,0 +1,226 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+/*
+ * A captured transponder in place of dvbsrc: HELIA_TS_FILE=<file | fifo | -> selects it,
+ * HELIA_TS_PACE=fast replays as fast as possible, otherwise at the PCR pace.
+ * The dvbsrc properties are mirrored, so the tuning code and "descr-get-tp" work unchanged.
+ */
+
+#include "ts-file.h"
+
+#include <stdlib.h>
+
+struct _TsFile
+{
+	GstBin parent_instance;
+
+	GHashTable *props;
+};
+
+G_DEFINE_TYPE ( TsFile, ts_file, GST_TYPE_BIN )
+
+static GParamSpec * ts_file_copy_pspec ( GParamSpec *pspec )
+{
+	const char *name  = g_param_spec_get_name  ( pspec );
+	const char *nick  = g_param_spec_get_nick  ( pspec );
+	const char *blurb = g_param_spec_get_blurb ( pspec );
+
+	GParamFlags flags = G_PARAM_READWRITE;
+
+	switch ( G_TYPE_FUNDAMENTAL ( pspec->value_type ) )
+	{
+		case G_TYPE_ENUM:
+			return g_param_spec_enum ( name, nick, blurb, pspec->value_type, G_PARAM_SPEC_ENUM ( pspec )->default_value, flags );
+
+		case G_TYPE_INT:
+		{
+			GParamSpecInt *p = G_PARAM_SPEC_INT ( pspec );
+			return g_param_spec_int ( name, nick, blurb, p->minimum, p->maximum, p->default_value, flags );
+		}
+
+		case G_TYPE_UINT:
+		{
+			GParamSpecUInt *p = G_PARAM_SPEC_UINT ( pspec );
+			return g_param_spec_uint ( name, nick, blurb, p->minimum, p->maximum, p->default_value, flags );
+		}
+
+		case G_TYPE_INT64:
+		{
+			GParamSpecInt64 *p = G_PARAM_SPEC_INT64 ( pspec );
+			return g_param_spec_int64 ( name, nick, blurb, p->minimum, p->maximum, p->default_value, flags );
+		}
+
+		case G_TYPE_UINT64:
+		{
+			GParamSpecUInt64 *p = G_PARAM_SPEC_UINT64 ( pspec );
+			return g_param_spec_uint64 ( name, nick, blurb, p->minimum, p->maximum, p->default_value, flags );
+		}
+
+		case G_TYPE_BOOLEAN:
+			return g_param_spec_boolean ( name, nick, blurb, G_PARAM_SPEC_BOOLEAN ( pspec )->default_value, flags );
+
+		case G_TYPE_STRING:
+			return g_param_spec_string ( name, nick, blurb, G_PARAM_SPEC_STRING ( pspec )->default_value, flags );
+
+		default:
+			return NULL;
+	}
+}
+
+static void ts_file_set_property ( GObject *object, G_GNUC_UNUSED guint id, const GValue *value, GParamSpec *pspec )
+{
+	TsFile *ts_file = TS_FILE ( object );
+
+	GValue *copy = g_new0 ( GValue, 1 );
+
+	g_value_init ( copy, pspec->value_type );
+	g_value_copy ( value, copy );
+
+	g_hash_table_insert ( ts_file->props, (gpointer)pspec->name, copy );
+}
+
+static void ts_file_get_property ( GObject *object, G_GNUC_UNUSED guint id, GValue *value, GParamSpec *pspec )
+{
+	TsFile *ts_file = TS_FILE ( object );
+
+	const GValue *stored = g_hash_table_lookup ( ts_file->props, pspec->name );
+
+	if ( stored ) g_value_copy ( stored, value ); else g_param_value_set_default ( pspec, value );
+}
+
+static void ts_file_value_free ( GValue *value )
+{
+	g_value_unset ( value );
+	free ( value );
+}
+
+/* There is no frontend: report a lock, as scan and the level bar wait for one */
+static void ts_file_post_lock ( GstElement *element )
+{
+	GstStructure *structure = gst_structure_new ( "dvb-frontend-stats",
+		"status", G_TYPE_INT, 0x1f, "signal", G_TYPE_INT, 0xffff, "snr", G_TYPE_INT, 0xffff,
+		"ber", G_TYPE_INT, 0, "unc", G_TYPE_INT, 0, "lock", G_TYPE_BOOLEAN, TRUE, NULL );
+
+	gst_element_post_message ( element, gst_message_new_element ( GST_OBJECT ( element ), structure ) );
+}
+
+static GstStateChangeReturn ts_file_change_state ( GstElement *element, GstStateChange transition )
+{
+	GstStateChangeReturn ret = GST_ELEMENT_CLASS ( ts_file_parent_class )->change_state ( element, transition );
+
+	if ( transition == GST_STATE_CHANGE_READY_TO_PAUSED && ret != GST_STATE_CHANGE_FAILURE ) ts_file_post_lock ( element );
+
+	return ret;
+}
+
+static void ts_file_init ( TsFile *ts_file )
+{
+	ts_file->props = g_hash_table_new_full ( g_str_hash, g_str_equal, NULL, (GDestroyNotify)ts_file_value_free );
+}
+
+static void ts_file_finalize ( GObject *object )
+{
+	TsFile *ts_file = TS_FILE ( object );
+
+	g_hash_table_unref ( ts_file->props );
+
+	G_OBJECT_CLASS ( ts_file_parent_class )->finalize ( object );
+}
+
+static void ts_file_class_init ( TsFileClass *class )
+{
+	GObjectClass *oclass = G_OBJECT_CLASS ( class );
+
+	oclass->finalize = ts_file_finalize;
+	oclass->set_property = ts_file_set_property;
+	oclass->get_property = ts_file_get_property;
+
+	GST_ELEMENT_CLASS ( class )->change_state = ts_file_change_state;
+
+	GstElement *dvbsrc = gst_element_factory_make ( "dvbsrc", NULL );
+
+	if ( !dvbsrc ) return;
+
+	uint i = 0, n_props = 0, id = 1;
+	GParamSpec **pspecs = g_object_class_list_properties ( G_OBJECT_GET_CLASS ( dvbsrc ), &n_props );
+
+	for ( i = 0; i < n_props; i++ )
+	{
+		if ( !( pspecs[i]->flags & G_PARAM_WRITABLE ) || g_object_class_find_property ( oclass, pspecs[i]->name ) ) continue;
+
+		GParamSpec *pspec = ts_file_copy_pspec ( pspecs[i] );
+
+		if ( pspec ) g_object_class_install_property ( oclass, id++, pspec );
+	}
+
+	free ( pspecs );
+	gst_object_unref ( dvbsrc );
+}
+
+TsFile * ts_file_new ( const char *location, gboolean realtime )
+{
+	TsFile *ts_file = g_object_new ( TS_TYPE_FILE, NULL );
+
+	gboolean pipe = g_str_equal ( location, "-" );
+
+	GstElement *src = gst_element_factory_make ( ( pipe ) ? "fdsrc" : "filesrc", NULL );
+	GstElement *last = src;
+
+	if ( !src ) { g_critical ( "%s:: %s - not created.", __func__, ( pipe ) ? "fdsrc" : "filesrc" ); return ts_file; }
+
+	if ( !pipe ) g_object_set ( src, "location", location, NULL );
+
+	gst_bin_add ( GST_BIN ( ts_file ), src );
+
+	/* tsparse stamps the packets from the PCR, clocksync holds them to the pipeline clock */
+	GstElement *tsparse   = ( realtime ) ? gst_element_factory_make ( "tsparse",   NULL ) : NULL;
+	GstElement *clocksync = ( realtime ) ? gst_element_factory_make ( "clocksync", NULL ) : NULL;
+
+	if ( tsparse && clocksync )
+	{
+		g_object_set ( tsparse, "set-timestamps", TRUE, NULL );
+
+		gst_bin_add_many ( GST_BIN ( ts_file ), tsparse, clocksync, NULL );
+		gst_element_link_many ( src, tsparse, clocksync, NULL );
+
+		last = clocksync;
+	}
+	else if ( realtime )
+	{
+		g_warning ( "%s:: tsparse or clocksync not available, replay at full speed. ", __func__ );
+
+		if ( tsparse   ) gst_object_unref ( tsparse   );
+		if ( clocksync ) gst_object_unref ( clocksync );
+	}
+
+	GstPad *pad = gst_element_get_static_pad ( last, "src" );
+	gst_element_add_pad ( GST_ELEMENT ( ts_file ), gst_ghost_pad_new ( "src", pad ) );
+	gst_object_unref ( pad );
+
+	g_debug ( "%s:: %s ( %s ) ", __func__, location, ( realtime ) ? "pcr pace" : "fast" );
+
+	return ts_file;
+}
+
+gboolean ts_file_active ( void )
+{
+	const char *file = g_getenv ( "HELIA_TS_FILE" );
+
+	return ( file && file[0] );
+}
+
+GstElement * ts_file_make_src ( void )
+{
+	if ( !ts_file_active () ) return gst_element_factory_make ( "dvbsrc", NULL );
+
+	const char *pace = g_getenv ( "HELIA_TS_PACE" );
+
+	return GST_ELEMENT ( ts_file_new ( g_getenv ( "HELIA_TS_FILE" ), !( pace && g_str_equal ( pace, "fast" ) ) ) );
+}
@@ -0,0 +1,22 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+
+#define TS_TYPE_FILE ts_file_get_type ()
+
+G_DECLARE_FINAL_TYPE ( TsFile, ts_file, TS, FILE, GstBin )
+
+TsFile * ts_file_new ( const char *, gboolean );
+
+gboolean ts_file_active ( void );
+
+GstElement * ts_file_make_src ( void );
@@ -0,0 +1,344 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "ts-rec.h"
+
+#include <glib.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <errno.h>
+
+/* 4096 packets: a multiple of both the TS packet and the page size */
+#define TS_REC_BATCH ( TS_PACKET_SIZE * 4096 )
+#define TS_REC_NUM_BATCH 8
+
+#define MAX_PID 8192
+
+enum TsRecPid
+{
+	PID_NONE,
+	PID_PAT,
+	PID_PMT,
+	PID_ES
+};
+
+typedef struct _TsRecBatch TsRecBatch;
+
+struct _TsRecBatch
+{
+	uint8_t *data;
+	size_t len;
+};
+
+struct _TsRec
+{
+	int fd;
+
+	GThread *thread;
+	GAsyncQueue *queue_full;
+	GAsyncQueue *queue_free;
+
+	uint16_t sid;
+	uint16_t pmt_pid;
+
+	int8_t pmt_version;
+
+	uint8_t pids[MAX_PID];
+
+	uint8_t part[TS_PACKET_SIZE];
+	size_t part_len;
+
+	TsRecBatch *batch;
+};
+
+static void ts_rec_write ( int fd, TsRecBatch *batch )
+{
+	size_t done = 0;
+
+	while ( done < batch->len )
+	{
+		ssize_t ret = write ( fd, batch->data + done, batch->len - done );
+
+		if ( ret == -1 && errno == EINTR ) continue;
+
+		if ( ret == -1 ) { g_warning ( "%s:: %s ", __func__, g_strerror ( errno ) ); break; }
+
+		done += (size_t)ret;
+	}
+
+	batch->len = 0;
+}
+
+/* Queued by ts_rec_free: everything before it is written, then the writer cleans up */
+static TsRecBatch ts_rec_end;
+
+/* Writers still flushing after ts_rec_free */
+static uint ts_rec_writers = 0;
+static GMutex ts_rec_mutex;
+static GCond  ts_rec_cond;
+
+static void ts_rec_close ( TsRec *ts_rec )
+{
+	if ( fsync ( ts_rec->fd ) == -1 ) g_debug ( "%s:: %s ", __func__, g_strerror ( errno ) );
+
+	close ( ts_rec->fd );
+
+	uint c = 0; for ( c = 0; c < TS_REC_NUM_BATCH; c++ )
+	{
+		TsRecBatch *batch = g_async_queue_pop ( ts_rec->queue_free );
+
+		free ( batch->data );
+		free ( batch );
+	}
+
+	g_async_queue_unref ( ts_rec->queue_full );
+	g_async_queue_unref ( ts_rec->queue_free );
+
+	free ( ts_rec );
+
+	g_mutex_lock ( &ts_rec_mutex );
+
+	ts_rec_writers--;
+	g_cond_broadcast ( &ts_rec_cond );
+
+	g_mutex_unlock ( &ts_rec_mutex );
+}
+
+static gpointer ts_rec_thread ( TsRec *ts_rec )
+{
+	while ( TRUE )
+	{
+		TsRecBatch *batch = g_async_queue_pop ( ts_rec->queue_full );
+
+		if ( batch == &ts_rec_end ) break;
+
+		ts_rec_write ( ts_rec->fd, batch );
+
+		g_async_queue_push ( ts_rec->queue_free, batch );
+	}
+
+	ts_rec_close ( ts_rec );
+
+	return NULL;
+}
+
+static const uint8_t * ts_rec_get_section ( const uint8_t *pkt, uint16_t *len )
+{
+	if ( !( pkt[1] & 0x40 ) ) return NULL;
+
+	uint8_t afc = ( pkt[3] >> 4 ) & 0x03;
+
+	if ( !( afc & 0x01 ) ) return NULL;
+
+	uint off = 4;
+
+	if ( afc & 0x02 ) off += 1u + pkt[4];
+
+	if ( off >= TS_PACKET_SIZE ) return NULL;
+
+	off += 1u + pkt[off];
+
+	if ( off + 3 > TS_PACKET_SIZE ) return NULL;
+
+	const uint8_t *sec = pkt + off;
+
+	*len = (uint16_t)( ( ( sec[1] & 0x0f ) << 8 ) | sec[2] );
+
+	/* PAT and PMT of a single program always fit into one packet in practice */
+	if ( off + 3 + *len > TS_PACKET_SIZE || *len < 9 ) return NULL;
+
+	return sec;
+}
+
+static void ts_rec_parse_pat ( TsRec *ts_rec, const uint8_t *pkt )
+{
+	uint16_t len = 0;
+	const uint8_t *sec = ts_rec_get_section ( pkt, &len );
+
+	if ( !sec || sec[0] != 0x00 ) return;
+
+	const uint8_t *end = sec + 3 + len - 4;
+
+	const uint8_t *p = NULL; for ( p = sec + 8; p + 4 <= end; p += 4 )
+	{
+		uint16_t program = (uint16_t)( ( p[0] << 8 ) | p[1] );
+		uint16_t pid = (uint16_t)( ( ( p[2] & 0x1f ) << 8 ) | p[3] );
+
+		if ( program != ts_rec->sid || pid == ts_rec->pmt_pid ) continue;
+
+		if ( ts_rec->pmt_pid ) ts_rec->pids[ts_rec->pmt_pid] = PID_NONE;
+
+		ts_rec->pmt_pid = pid;
+		ts_rec->pmt_version = -1;
+		ts_rec->pids[pid] = PID_PMT;
+
+		g_debug ( "%s:: sid %u -> pmt pid %u ", __func__, program, pid );
+	}
+}
+
+static void ts_rec_parse_pmt ( TsRec *ts_rec, const uint8_t *pkt )
+{
+	uint16_t len = 0;
+	const uint8_t *sec = ts_rec_get_section ( pkt, &len );
+
+	if ( !sec || sec[0] != 0x02 ) return;
+
+	uint16_t program = (uint16_t)( ( sec[3] << 8 ) | sec[4] );
+	int8_t version = (int8_t)( ( sec[5] >> 1 ) & 0x1f );
+
+	if ( program != ts_rec->sid || version == ts_rec->pmt_version ) return;
+
+	uint c = 0; for ( c = 0; c < MAX_PID; c++ ) if ( ts_rec->pids[c] == PID_ES ) ts_rec->pids[c] = PID_NONE;
+
+	uint16_t pcr_pid = (uint16_t)( ( ( sec[8] & 0x1f ) << 8 ) | sec[9] );
+	uint16_t pi_len  = (uint16_t)( ( ( sec[10] & 0x0f ) << 8 ) | sec[11] );
+
+	if ( pcr_pid != 0x1fff && ts_rec->pids[pcr_pid] == PID_NONE ) ts_rec->pids[pcr_pid] = PID_ES;
+
+	const uint8_t *end = sec + 3 + len - 4;
+
+	const uint8_t *p = NULL; for ( p = sec + 12 + pi_len; p + 5 <= end; p += 5 + ( ( ( p[3] & 0x0f ) << 8 ) | p[4] ) )
+	{
+		uint16_t pid = (uint16_t)( ( ( p[1] & 0x1f ) << 8 ) | p[2] );
+
+		if ( ts_rec->pids[pid] == PID_NONE ) ts_rec->pids[pid] = PID_ES;
+
+		g_debug ( "%s:: sid %u: stream type 0x%02x pid %u ", __func__, program, p[0], pid );
+	}
+
+	ts_rec->pmt_version = version;
+}
+
+static void ts_rec_packet ( TsRec *ts_rec, const uint8_t *pkt )
+{
+	if ( ts_rec->sid )
+	{
+		uint16_t pid = (uint16_t)( ( ( pkt[1] & 0x1f ) << 8 ) | pkt[2] );
+
+		if ( ts_rec->pids[pid] == PID_NONE ) return;
+
+		if ( ts_rec->pids[pid] == PID_PAT ) ts_rec_parse_pat ( ts_rec, pkt );
+		if ( ts_rec->pids[pid] == PID_PMT ) ts_rec_parse_pmt ( ts_rec, pkt );
+	}
+
+	if ( ts_rec->batch == NULL ) ts_rec->batch = g_async_queue_pop ( ts_rec->queue_free );
+
+	memcpy ( ts_rec->batch->data + ts_rec->batch->len, pkt, TS_PACKET_SIZE );
+	ts_rec->batch->len += TS_PACKET_SIZE;
+
+	if ( ts_rec->batch->len < TS_REC_BATCH ) return;
+
+	g_async_queue_push ( ts_rec->queue_full, ts_rec->batch );
+	ts_rec->batch = NULL;
+}
+
+void ts_rec_push ( TsRec *ts_rec, const uint8_t *data, size_t size )
+{
+	size_t i = 0;
+
+	if ( ts_rec->part_len )
+	{
+		size_t need = TS_PACKET_SIZE - ts_rec->part_len;
+
+		if ( size < need )
+		{
+			memcpy ( ts_rec->part + ts_rec->part_len, data, size );
+			ts_rec->part_len += size;
+
+			return;
+		}
+
+		memcpy ( ts_rec->part + ts_rec->part_len, data, need );
+		ts_rec->part_len = 0;
+
+		i = need;
+
+		if ( ts_rec->part[0] == 0x47 ) ts_rec_packet ( ts_rec, ts_rec->part );
+	}
+
+	while ( i < size )
+	{
+		if ( data[i] != 0x47 ) { i++; continue; }
+
+		if ( size - i < TS_PACKET_SIZE )
+		{
+			memcpy ( ts_rec->part, data + i, size - i );
+			ts_rec->part_len = size - i;
+
+			break;
+		}
+
+		ts_rec_packet ( ts_rec, data + i );
+
+		i += TS_PACKET_SIZE;
+	}
+}
+
+/* Runs on the main thread when the record branch is detached: the flush, fsync and close stay in the writer thread */
+void ts_rec_free ( TsRec *ts_rec )
+{
+	if ( ts_rec->batch && ts_rec->batch->len )
+		g_async_queue_push ( ts_rec->queue_full, ts_rec->batch );
+	else if ( ts_rec->batch )
+		g_async_queue_push ( ts_rec->queue_free, ts_rec->batch );
+
+	GThread *thread = ts_rec->thread;
+
+	g_async_queue_push ( ts_rec->queue_full, &ts_rec_end );
+
+	g_thread_unref ( thread );
+}
+
+/* Before the process exits: the last recordings are on disk */
+void ts_rec_wait ( void )
+{
+	g_mutex_lock ( &ts_rec_mutex );
+
+	while ( ts_rec_writers ) g_cond_wait ( &ts_rec_cond, &ts_rec_mutex );
+
+	g_mutex_unlock ( &ts_rec_mutex );
+}
+
+TsRec * ts_rec_new ( const char *path, uint16_t sid )
+{
+	int fd = open ( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+
+	if ( fd == -1 ) { g_warning ( "%s:: %s %s ", __func__, path, g_strerror ( errno ) ); return NULL; }
+
+	TsRec *ts_rec = g_new0 ( TsRec, 1 );
+
+	ts_rec->queue_full = g_async_queue_new ();
+	ts_rec->queue_free = g_async_queue_new ();
+
+	uint c = 0; for ( c = 0; c < TS_REC_NUM_BATCH; c++ )
+	{
+		TsRecBatch *batch = g_new0 ( TsRecBatch, 1 );
+
+		if ( posix_memalign ( (void **)&batch->data, 4096, TS_REC_BATCH ) != 0 ) g_error ( "%s:: batch buffer - not allocated. ", __func__ );
+
+		g_async_queue_push ( ts_rec->queue_free, batch );
+	}
+
+	ts_rec->fd  = fd;
+	ts_rec->sid = sid;
+	ts_rec->pmt_version = -1;
+	ts_rec->pids[0] = PID_PAT;
+
+	g_mutex_lock ( &ts_rec_mutex );
+	ts_rec_writers++;
+	g_mutex_unlock ( &ts_rec_mutex );
+
+	ts_rec->thread = g_thread_new ( "ts-rec", (GThreadFunc)ts_rec_thread, ts_rec );
+
+	return ts_rec;
+}
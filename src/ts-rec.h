@@ -0,0 +1,25 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TS_PACKET_SIZE 188
+
+typedef struct _TsRec TsRec;
+
+TsRec * ts_rec_new ( const char *, uint16_t );
+
+void ts_rec_push ( TsRec *, const uint8_t *, size_t );
+
+void ts_rec_free ( TsRec * );
+
+void ts_rec_wait ( void );
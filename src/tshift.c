@@ -0,0 +1,310 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "tshift.h"
+#include "ts-rec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+/* One index slot per PCR second */
+#define TSHIFT_IDX 8192
+
+#define TSHIFT_NO_PCR 0xffff
+
+struct _TShift
+{
+	GMutex mutex;
+
+	uint8_t *ring;
+	guint64 cap;
+
+	guint64 wr;
+	guint64 rd;
+
+	uint16_t pcr_pid;
+	guint64 pcr_sec;
+
+	guint64 cur_sec;
+	guint64 first_sec;
+	guint64 play_sec;
+	gint64  play_frac;
+
+	guint64 idx[TSHIFT_IDX];
+
+	gboolean live;
+
+	uint8_t part[TS_PACKET_SIZE];
+	size_t part_len;
+};
+
+static gboolean tshift_get_pcr_sec ( const uint8_t *pkt, guint64 *sec )
+{
+	if ( !( pkt[3] & 0x20 ) || pkt[4] < 7 || !( pkt[5] & 0x10 ) ) return FALSE;
+
+	guint64 base = ( (guint64)pkt[6] << 25 ) | ( (guint64)pkt[7] << 17 ) | ( (guint64)pkt[8] << 9 ) | ( (guint64)pkt[9] << 1 ) | ( pkt[10] >> 7 );
+
+	*sec = base / 90000;
+
+	return TRUE;
+}
+
+static void tshift_trim ( TShift *tshift )
+{
+	guint64 oldest = ( tshift->wr > tshift->cap ) ? tshift->wr - tshift->cap : 0;
+
+	while ( tshift->first_sec < tshift->cur_sec && ( tshift->idx[tshift->first_sec % TSHIFT_IDX] < oldest || tshift->cur_sec - tshift->first_sec >= TSHIFT_IDX - 1 ) )
+		tshift->first_sec++;
+}
+
+static void tshift_index ( TShift *tshift, const uint8_t *pkt )
+{
+	uint16_t pid = (uint16_t)( ( ( pkt[1] & 0x1f ) << 8 ) | pkt[2] );
+
+	if ( tshift->pcr_pid != TSHIFT_NO_PCR && pid != tshift->pcr_pid ) return;
+
+	guint64 sec = 0;
+
+	if ( !tshift_get_pcr_sec ( pkt, &sec ) ) return;
+
+	if ( tshift->pcr_pid == TSHIFT_NO_PCR )
+	{
+		tshift->pcr_pid = pid;
+		tshift->pcr_sec = sec;
+
+		tshift->idx[tshift->cur_sec % TSHIFT_IDX] = tshift->wr;
+
+		return;
+	}
+
+	if ( sec == tshift->pcr_sec ) return;
+
+	/* A PCR jump (discontinuity or wrap) counts as one second */
+	guint64 delta = ( sec > tshift->pcr_sec && sec - tshift->pcr_sec <= 5 ) ? sec - tshift->pcr_sec : 1;
+
+	tshift->pcr_sec = sec;
+
+	while ( delta-- )
+	{
+		tshift->cur_sec++;
+		tshift->idx[tshift->cur_sec % TSHIFT_IDX] = tshift->wr;
+	}
+
+	tshift_trim ( tshift );
+}
+
+static void tshift_packet ( TShift *tshift, const uint8_t *pkt )
+{
+	tshift_index ( tshift, pkt );
+
+	memcpy ( tshift->ring + ( tshift->wr % tshift->cap ) * TS_PACKET_SIZE, pkt, TS_PACKET_SIZE );
+
+	tshift->wr++;
+}
+
+void tshift_write ( TShift *tshift, const uint8_t *data, size_t size )
+{
+	size_t i = 0;
+
+	g_mutex_lock ( &tshift->mutex );
+
+	if ( tshift->part_len )
+	{
+		size_t need = TS_PACKET_SIZE - tshift->part_len;
+
+		if ( size < need )
+		{
+			memcpy ( tshift->part + tshift->part_len, data, size );
+			tshift->part_len += size;
+
+			g_mutex_unlock ( &tshift->mutex );
+
+			return;
+		}
+
+		memcpy ( tshift->part + tshift->part_len, data, need );
+		tshift->part_len = 0;
+
+		i = need;
+
+		if ( tshift->part[0] == 0x47 ) tshift_packet ( tshift, tshift->part );
+	}
+
+	while ( i < size )
+	{
+		if ( data[i] != 0x47 ) { i++; continue; }
+
+		if ( size - i < TS_PACKET_SIZE )
+		{
+			memcpy ( tshift->part, data + i, size - i );
+			tshift->part_len = size - i;
+
+			break;
+		}
+
+		tshift_packet ( tshift, data + i );
+
+		i += TS_PACKET_SIZE;
+	}
+
+	g_mutex_unlock ( &tshift->mutex );
+}
+
+size_t tshift_read ( TShift *tshift, uint8_t *data, size_t size, gint64 elapsed )
+{
+	g_mutex_lock ( &tshift->mutex );
+
+	if ( tshift->live ) { g_mutex_unlock ( &tshift->mutex ); return 0; }
+
+	tshift->play_frac += elapsed;
+
+	while ( tshift->play_frac >= G_USEC_PER_SEC ) { tshift->play_sec++; tshift->play_frac -= G_USEC_PER_SEC; }
+
+	guint64 target = tshift->wr;
+
+	if ( tshift->play_sec < tshift->cur_sec )
+	{
+		guint64 pos_a = tshift->idx[tshift->play_sec % TSHIFT_IDX];
+		guint64 pos_b = tshift->idx[( tshift->play_sec + 1 ) % TSHIFT_IDX];
+
+		target = pos_a + ( pos_b - pos_a ) * (guint64)tshift->play_frac / G_USEC_PER_SEC;
+	}
+
+	guint64 oldest = ( tshift->wr > tshift->cap ) ? tshift->wr - tshift->cap : 0;
+
+	if ( tshift->rd < oldest ) tshift->rd = oldest;
+
+	guint64 num = ( target > tshift->rd ) ? target - tshift->rd : 0;
+
+	if ( num > size / TS_PACKET_SIZE ) num = size / TS_PACKET_SIZE;
+
+	guint64 c = 0; for ( c = 0; c < num; c++ )
+	{
+		memcpy ( data + c * TS_PACKET_SIZE, tshift->ring + ( ( tshift->rd + c ) % tshift->cap ) * TS_PACKET_SIZE, TS_PACKET_SIZE );
+	}
+
+	tshift->rd += num;
+
+	if ( tshift->play_sec >= tshift->cur_sec && tshift->rd >= tshift->wr ) tshift->live = TRUE;
+
+	g_mutex_unlock ( &tshift->mutex );
+
+	return (size_t)num * TS_PACKET_SIZE;
+}
+
+gboolean tshift_seek ( TShift *tshift, int sec )
+{
+	g_mutex_lock ( &tshift->mutex );
+
+	if ( tshift->live )
+	{
+		tshift->live = FALSE;
+
+		tshift->rd = tshift->wr;
+		tshift->play_sec  = tshift->cur_sec;
+		tshift->play_frac = 0;
+	}
+
+	tshift_trim ( tshift );
+
+	gint64 play = (gint64)tshift->play_sec + sec;
+
+	if ( play < (gint64)tshift->first_sec ) play = (gint64)tshift->first_sec;
+
+	if ( sec > 0 && play >= (gint64)tshift->cur_sec )
+	{
+		tshift->live = TRUE;
+	}
+	else if ( sec != 0 )
+	{
+		tshift->play_sec  = (guint64)play;
+		tshift->play_frac = 0;
+
+		tshift->rd = tshift->idx[tshift->play_sec % TSHIFT_IDX];
+	}
+
+	gboolean live = tshift->live;
+
+	g_debug ( "%s:: delay %" G_GUINT64_FORMAT " s ", __func__, tshift->cur_sec - tshift->play_sec );
+
+	g_mutex_unlock ( &tshift->mutex );
+
+	return live;
+}
+
+gboolean tshift_is_live ( TShift *tshift )
+{
+	g_mutex_lock ( &tshift->mutex );
+
+	gboolean live = tshift->live;
+
+	g_mutex_unlock ( &tshift->mutex );
+
+	return live;
+}
+
+void tshift_set_live ( TShift *tshift )
+{
+	g_mutex_lock ( &tshift->mutex );
+
+	tshift->live = TRUE;
+
+	g_mutex_unlock ( &tshift->mutex );
+}
+
+void tshift_free ( TShift *tshift )
+{
+	munmap ( tshift->ring, tshift->cap * TS_PACKET_SIZE );
+
+	g_mutex_clear ( &tshift->mutex );
+
+	free ( tshift );
+}
+
+TShift * tshift_new ( uint size_mb )
+{
+	guint64 cap = (guint64)size_mb * 1024 * 1024 / TS_PACKET_SIZE;
+
+	if ( cap == 0 ) return NULL;
+
+	char *path = g_build_filename ( g_get_user_cache_dir (), "helia-tshift-XXXXXX", NULL );
+
+	int fd = mkstemp ( path );
+
+	if ( fd == -1 ) { g_warning ( "%s:: %s %s ", __func__, path, g_strerror ( errno ) ); free ( path ); return NULL; }
+
+	/* The ring only lives as long as the mapping */
+	unlink ( path );
+	free ( path );
+
+	if ( ftruncate ( fd, (off_t)( cap * TS_PACKET_SIZE ) ) == -1 ) { g_warning ( "%s:: %s ", __func__, g_strerror ( errno ) ); close ( fd ); return NULL; }
+
+	uint8_t *ring = mmap ( NULL, cap * TS_PACKET_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+
+	close ( fd );
+
+	if ( ring == MAP_FAILED ) { g_warning ( "%s:: %s ", __func__, g_strerror ( errno ) ); return NULL; }
+
+	TShift *tshift = g_new0 ( TShift, 1 );
+
+	g_mutex_init ( &tshift->mutex );
+
+	tshift->ring = ring;
+	tshift->cap  = cap;
+	tshift->live = TRUE;
+	tshift->pcr_pid = TSHIFT_NO_PCR;
+
+	return tshift;
+}
@@ -0,0 +1,29 @@
+/*
+* Copyright 2022 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+typedef struct _TShift TShift;
+
+TShift * tshift_new ( uint );
+
+void tshift_write ( TShift *, const uint8_t *, size_t );
+
+size_t tshift_read ( TShift *, uint8_t *, size_t, gint64 );
+
+gboolean tshift_seek ( TShift *, int );
+
+gboolean tshift_is_live ( TShift * );
+
+void tshift_set_live ( TShift * );
+
+void tshift_free ( TShift * );